@@ -58,6 +58,8 @@ struct io_workload;
 struct async_queue;
 struct async_queue_entry;
 struct io_worker;
+struct verify_pool;
+struct verify_ring;
 
 
 typedef apr_status_t (*iocallback_t)(struct async_queue *queue, struct async_queue_entry *ioop);
@@ -71,11 +73,16 @@ struct io_request {
 	void *buf;
 	uint64_t bufsize;
 
+	/* Submit at this time relative to start of the test. 0 to submit at once */
+	apr_time_t scheduled;
+
 	apr_time_t pre_submission;
 	apr_time_t post_submission;
 	apr_time_t completed;
 
 	int write;
+	/* Discard the range instead of reading or writing it */
+	int discard;
 };
 
 struct async_queue_entry {
@@ -84,6 +91,12 @@ struct async_queue_entry {
     struct io_request request;
 
 	iocallback_t callback;
+
+	/* pipelined verification: bytes to verify, 0 for none, and when it ran */
+	struct async_queue *owner;
+	uint64_t verify_size;
+	apr_time_t verify_start;
+	apr_time_t verify_end;
 };
 
 struct async_queue {
@@ -98,6 +111,10 @@ struct async_queue {
 	struct async_queue_entry *ioaqes;
 	struct async_ioop_ring *ready;
 
+	/* entries out for verification and the ring they come back on */
+	uint32_t verifying;
+	struct verify_ring *verified;
+
 	struct async_platform_queue *platform_queue;
 };
 
@@ -113,12 +130,78 @@ struct io_workload_generator {
     void *generator_data;
 };
 
+/* Placement of worker threads and IO buffers relative to the NUMA node of the device */
+#define NUMA_OFF 0
+#define NUMA_LOCAL 1
+#define NUMA_REMOTE 2
+#define NUMA_COMPARE 3
+
+/* Access pattern advice for memory mapped files */
+#define MAP_ADVICE_SEQUENTIAL 1
+#define MAP_ADVICE_RANDOM 2
+#define MAP_ADVICE_HUGEPAGE 4
+
+/* Request arrivals in open-loop mode */
+#define ARRIVAL_FIXED 1
+#define ARRIVAL_POISSON 2
+
+/* Log-linear latency histogram, 16 buckets per power of two microseconds */
+#define LATENCY_BUCKETS 640
+
+/* Maximum iovecs per request in vectored mode */
+#define MAX_IO_SEGMENTS 1024
+
+/* IO buffer allocation flags */
+#define IO_BUFFER_HUGETLB 1
+#define IO_BUFFER_THP 2
+#define IO_BUFFER_POPULATE 4
+#define IO_BUFFER_LOCK 8
+
 struct io_worker_options {
     struct platform_ops *platform_ops;
 
     int write_random;
     int keep_files;
+    /* use the page cache (no O_DIRECT) */
+    int buffered;
+    /* evict the page cache between tests in buffered mode */
+    int cold_cache;
+    /* mmap engine: MAP_ADVICE_* flags */
+    int map_advice;
     int validate_existing;
+    /* io_uring: let a kernel thread poll the submission queue */
+    int sqpoll;
+    /* minimum number of completions reaped per blocking wait */
+    int reap_batch;
+    /* busy-poll for completions instead of sleeping */
+    int polled;
+    /* NUMA_* placement of threads and IO buffers relative to the device */
+    int numa_mode;
+    /* IO_BUFFER_* flags for new IO buffers */
+    int buffer_flags;
+    /* open-loop: total IOPS offered in the current test, 0 for closed loop */
+    double target_iops;
+    /* IOPS to offer, each test is repeated per rate */
+    apr_array_header_t *rate_array;
+    /* ARRIVAL_* */
+    int arrival;
+    /* iovecs per request in the current test, 1 for contiguous IO */
+    int io_segments;
+    /* sector size of the devices, direct IO segments are multiples of it */
+    uint32_t sector_size;
+    /* segment counts to test, each test is repeated per count */
+    apr_array_header_t *io_segments_array;
+    /* bytes at the start of each worker's range used by random IO, 0 for all */
+    uint64_t working_set;
+    /* working sets to test, each test is repeated per size */
+    apr_array_header_t *working_set_array;
+    /* WAL tests: fdatasync after this many writes or this often, 0 for none */
+    int commit_writes;
+    apr_time_t commit_interval;
+    /* verifier threads shared by all workers, NULL to verify on the ioworker */
+    struct verify_pool *verify_pool;
+    /* bytes of pre-generated random data per worker, 0 to generate every write */
+    uint64_t pattern_pool_size;
     apr_time_t max_execution_time;
     apr_time_t max_preparation_time;
 
@@ -144,9 +227,26 @@ struct io_worker {
 	uint64_t last_integrity_written_offset;
 
 	uint64_t random_seed;
+	/* random writes are copied from here if set, shared with threads of the worker */
+	uint64_t *pattern_pool;
+	uint64_t pattern_pool_sectors;
+	/* IO_BUFFER_* flags the IO buffer was allocated with */
+	int buffer_flags;
 
     int truncate_file;
 
+    /* Set for extra threads sharing the file of parent */
+    struct io_worker *parent;
+    /* Added to all request offsets, start of this thread's part of the file */
+    uint64_t offset_base;
+
+    /* NUMA node of the device, -1 if unknown */
+    int device_node;
+    /* NUMA node the thread and buffer are bound to, -1 for no binding */
+    int numa_node;
+    /* CPU the thread is pinned to, -1 for no pinning */
+    int cpu;
+
     char *description;
 };
 
@@ -178,6 +278,30 @@ struct io_workload {
 	int queue_depth;
 	int max_active;
 
+	/* requests per second offered to this queue, 0 for closed loop */
+	double arrival_rate;
+	/* completions by latency_bucket() of latency */
+	uint64_t latency_histogram[LATENCY_BUCKETS];
+
+	/* commits, from first write of the group until fdatasync returned */
+	uint64_t commits;
+	apr_time_t sync_elapsed;
+	apr_time_t commit_max_latency;
+	uint64_t commit_histogram[LATENCY_BUCKETS];
+
+	/* discards issued synchronously by ioworker */
+	uint64_t discards;
+	uint64_t discard_bytes;
+	uint64_t discard_failures;
+	apr_time_t discard_elapsed;
+
+	/* reads verified by the verify pool */
+	uint64_t verify_requests;
+	uint64_t verify_bytes;
+	/* time spent verifying, and from completion until verified */
+	apr_time_t verify_elapsed;
+	apr_time_t verify_delay;
+
     char *description;
 };
 
@@ -230,23 +354,50 @@ struct io_statistics_line {
 	double bytes_per_second;
     double weighted_bytes_per_second;
 	double iops;
+
+	/* Bytes that reached storage, only measured in buffered mode */
+	uint64_t device_bytes_read;
+	uint64_t device_bytes_written;
+
+	/* CPU time of the process in percent of one core */
+	double cpu_utilization;
 };
 
 APR_RING_HEAD(async_ioop_ring, async_queue_entry);
 
 
 struct platform_ops {
-    apr_status_t (*create_io_buffer)(void **buf, uint64_t size);
+    /* Allocate IO buffer with IO_BUFFER_* flags. used_flags is set to the flags that could be honored */
+    apr_status_t (*create_io_buffer)(void **buf, uint64_t size, int flags, int *used_flags);
 
 	apr_size_t (*get_page_size)();
     apr_size_t (*get_min_iosize)();
 
+    /* Bytes this process has read from/written to storage. May be NULL */
+    apr_status_t (*get_io_counters)(uint64_t *read_bytes, uint64_t *write_bytes);
+    /* User+system CPU time consumed by all threads of this process */
+    apr_status_t (*get_cpu_time)(apr_time_t *cpu_time);
+
+    /* NUMA placement, all may be NULL. Number of NUMA nodes, 1 if unknown */
+    int (*get_numa_nodes)();
+    /* Pin calling thread to cpu, or to the cpus of node if cpu is -1 */
+    apr_status_t (*bind_thread)(int cpu, int node);
+    /* Move buffer memory to node */
+    apr_status_t (*bind_io_buffer)(void *buf, uint64_t size, int node);
 
-	apr_status_t (*file_open)(char *filename, uint64_t *length, double freespace_utilization,
+	apr_status_t (*file_open)(char *filename, int buffered, uint64_t *length, double freespace_utilization,
                            int *file_truncated, struct platform_file **rv);
 	apr_status_t (*file_truncate)(struct platform_file *the_file, uint64_t *length);
 	apr_status_t (*file_close)(struct platform_file *the_file);
 	apr_status_t (*file_flush)(struct platform_file *the_file);
+	/* Make written data durable, metadata only as far as needed to read it back */
+	apr_status_t (*file_datasync)(struct platform_file *the_file);
+	/* Drop cached pages of the file. May be NULL */
+	apr_status_t (*file_evict)(struct platform_file *the_file);
+	/* Discard (block devices) or punch a hole (files) in a range. May be NULL */
+	apr_status_t (*file_discard)(struct platform_file *the_file, uint64_t offset, uint64_t length);
+	/* NUMA node of the device holding the file, -1 if unknown. May be NULL */
+	apr_status_t (*file_numa_node)(struct platform_file *the_file, int *node);
 
 	apr_status_t (*queue_create)(struct async_queue *queue);
 	apr_status_t (*queue_destroy)(struct async_queue *queue);
@@ -254,15 +405,52 @@ struct platform_ops {
 	apr_status_t (*queue_read)(struct async_queue *queue, struct async_queue_entry *ioop);
 	apr_status_t (*queue_write)(struct async_queue *queue, struct async_queue_entry *ioop);
 
-	apr_status_t (*queue_wait)(struct async_queue *queue, int block);
+	/* Blocking wait for at least min_events completions. Non-blocking if min_events is 0 */
+	apr_status_t (*queue_wait)(struct async_queue *queue, int min_events);
+
+	/* Submit reads/writes queued since last submit. May be NULL if reads/writes are submitted directly */
+	apr_status_t (*queue_submit)(struct async_queue *queue);
+
+	/* engine name used for runtime selection */
+	const char *name;
 };
 
 extern struct platform_ops *platform_ops;
+
+/*
+ * Find IO engine by name. Returns NULL if the platform has no such engine
+ */
+struct platform_ops *platform_ops_lookup(const char *name);
 apr_status_t generic_queue_notify(
 	struct async_queue *queue,
 	struct async_queue_entry *ioop);
 
 
+/* Data pattern, see data_pattern.c */
+#define DATA_PATTERN_SECTOR 512
+#define NONRANDOM_CONSTANT UINT64_C(0xABCDEF9876543210)
+
+/* Select the fill kernel by name ("auto" picks the fastest supported). Returns 0 if unknown or unsupported */
+int data_pattern_select(const char *name);
+const char *data_pattern_kernel();
+/* Fill a write buffer with the verifiable pattern for offset */
+void data_pattern_fill(void *buf, uint64_t size, uint64_t offset, int random, uint64_t *seed);
+/* Return 1 if buf holds the pattern written at offset */
+int data_pattern_verify(const void *buf, uint64_t size, uint64_t offset, int random);
+/* Print fill and verify throughput of the supported kernels */
+void data_pattern_benchmark();
+/* Pre-generated random sectors, and writes copied from them */
+uint64_t *data_pattern_pool_create(uint64_t size, uint64_t *seed);
+void data_pattern_fill_pool(void *buf, uint64_t size, uint64_t offset, const uint64_t *pool, uint64_t pool_sectors, uint64_t *seed);
+
+/* Verifier threads, see verify_pool.c */
+apr_status_t verify_pool_create(struct verify_pool **verify_pool, int threads, apr_pool_t *pool);
+apr_status_t verify_pool_destroy(struct verify_pool *verify_pool);
+struct verify_ring *verify_ring_create(apr_pool_t *pool, uint32_t capacity);
+void verify_pool_submit(struct verify_pool *verify_pool, struct async_queue_entry *entry);
+int verify_pool_reap(struct async_queue *queue, int block);
+void integrity_error(struct io_request *request);
+
 /* Fast 64-bit random generator */
 static inline uint64_t random_uint64_t(uint64_t *seed)
 {
@@ -273,6 +461,29 @@ static inline uint64_t random_uint64_t(uint64_t *seed)
     return (*seed^=(*seed<<17));
 }
 
+/* Histogram bucket of a latency. Exact below 16us, within 6.25% above */
+static inline int latency_bucket(apr_time_t latency)
+{
+    uint64_t value = latency > 0 ? (uint64_t) latency : 0;
+    int msb = 4;
+    int bucket;
+
+    if(value < 16)
+        return (int) value;
+    while((value >> (msb + 1)) != 0)
+        ++msb;
+    bucket = (msb - 3)*16 + (int) ((value >> (msb - 4)) & 15);
+    return bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1;
+}
+
+/* Smallest latency in bucket */
+static inline apr_time_t latency_bucket_value(int bucket)
+{
+    if(bucket < 16)
+        return bucket;
+    return (apr_time_t) ((uint64_t) (16 + bucket % 16) << (bucket/16 - 1));
+}
+
 /* Helper function */
 static inline apr_time_t min_time(apr_time_t a, apr_time_t b) {
     return a <= b ? a : b;
@@ -303,6 +514,11 @@ apr_status_t generic_queue_wait(struct async_queue *queue, int *events);
  */
 apr_status_t generic_queue_barrier(struct async_queue *queue);
 
+/*
+ * Submit all queued reads/writes in one batch
+ */
+apr_status_t generic_queue_submit(struct async_queue *queue);
+
 /*
  * Queue a read
  */
@@ -335,5 +551,134 @@ apr_status_t random_request_generator_factory(
     struct io_workload_generator **request_generator,
     int write);
 
+/*
+ * Create a random request generator with offsets aligned to alignment
+ * instead of the request size. 0 aligns to the request size
+ */
+apr_status_t random_request_generator_aligned_factory(
+    struct io_workload_generator **request_generator,
+    int write,
+    uint64_t alignment);
+
+/* Maximum number of sizes in a mixed profile size distribution */
+#define MIXED_MAX_SIZES 64
+
+struct mixed_size_distribution {
+    int count;
+    uint64_t sizes[MIXED_MAX_SIZES];
+    double weights[MIXED_MAX_SIZES];
+};
+
+/* Mixed workload description */
+struct mixed_profile {
+    char *name;
+
+    double read_fraction;
+    /* fraction of reads/writes that are sequential */
+    double sequential_read_fraction;
+    double sequential_write_fraction;
+
+    /* size distributions, count 0 for the default centred at 4k/128k */
+    struct mixed_size_distribution random_sizes;
+    struct mixed_size_distribution sequential_sizes;
+};
+
+/*
+ * Initialize profile to the Totaliaris mix
+ */
+void mixed_profile_default(struct mixed_profile *profile);
+
+/*
+ * Create a mixed request generator. Uses the Totaliaris mix if profile is NULL
+ */
+apr_status_t mixed_request_generator_factory(
+    struct io_workload_generator **request_generator,
+    const struct mixed_profile *profile);
+
+/*
+ * Create a generator replaying a blkparse or CSV trace. With timed set requests
+ * are scheduled at their trace timestamps, otherwise replayed as fast as possible
+ */
+apr_status_t trace_request_generator_factory(
+    struct io_workload_generator **request_generator,
+    const char *filename,
+    int timed,
+    apr_pool_t *pool);
+
+/* Offset distributions of the skewed generator */
+#define SKEW_ZIPF 1
+#define SKEW_HOTSPOT 2
+
+/*
+ * Create a random request generator with skewed offsets. SKEW_ZIPF takes
+ * theta (0 < theta < 1) as param1. SKEW_HOTSPOT sends the fraction param1
+ * of the requests to the fraction param2 of the file.
+ */
+apr_status_t skewed_request_generator_factory(
+    struct io_workload_generator **request_generator,
+    int write,
+    int distribution,
+    double param1,
+    double param2);
+
+/* Maximum number of streams of the multi-stream generator */
+#define MAX_STREAMS 1024
+
+/* Placement of the streams in the file */
+#define STREAMS_REGION 1
+#define STREAMS_INTERLEAVED 2
+
+/* Stream continued by each request */
+#define STREAMS_ROUND_ROBIN 1
+#define STREAMS_RANDOM 2
+
+/*
+ * Create a generator with streams independent sequential streams, placed
+ * by layout (STREAMS_REGION or STREAMS_INTERLEAVED) and picked per request
+ * by order (STREAMS_ROUND_ROBIN or STREAMS_RANDOM)
+ */
+apr_status_t multistream_request_generator_factory(
+    struct io_workload_generator **request_generator,
+    int write,
+    int streams,
+    int layout,
+    int order);
+
+/* Access patterns of the pattern generator */
+#define PATTERN_STRIDED 1
+#define PATTERN_REVERSE 2
+#define PATTERN_BUTTERFLY 3
+
+/*
+ * Create a strided, reverse sequential or butterfly request generator.
+ * gap is the number of bytes skipped between strided requests
+ */
+apr_status_t pattern_request_generator_factory(
+    struct io_workload_generator **request_generator,
+    int write,
+    int pattern,
+    uint64_t gap);
+
+/* Log placement of the WAL generator */
+#define WAL_APPEND 1
+#define WAL_OVERWRITE 2
+
+/*
+ * Create a write-ahead log generator. WAL_OVERWRITE rewrites the first
+ * group_writes requests of the file, WAL_APPEND writes through the file
+ */
+apr_status_t wal_request_generator_factory(
+    struct io_workload_generator **request_generator,
+    int mode,
+    int group_writes);
+
+/*
+ * Create a generator rewriting regions of granularity bytes at random and
+ * discarding the fraction of them before they are rewritten
+ */
+apr_status_t discard_request_generator_factory(
+    struct io_workload_generator **request_generator,
+    double fraction,
+    uint64_t granularity);
 
 #endif /*DISKBENCH_H_*/
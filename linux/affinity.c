@@ -0,0 +1,157 @@
+/*
+  * affinity.c
+  *
+  * Part of diskBench - IO bandwidth measurement
+  *
+  * Copyright (C) 2010-2011  Amund Elstad <amund.elstad@gmail.com>
+  *
+  *  This program is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *   the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  This program is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *   GNU General Public License for more details.
+  *
+  *   You should have received a copy of the GNU General Public License
+  *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+#include "linux.h"
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+
+/*
+ * CPU and NUMA placement for the linux engines. Uses sysfs and the raw
+ * mbind system call, so libnuma is not needed.
+ */
+
+/* Parse a sysfs list like 0-3,8-11 */
+static int linux_parse_list(const char *path, cpu_set_t *set)
+{
+	FILE *f;
+	char line[4096];
+	char *token, *last;
+	int from, to, count = 0;
+
+	CPU_ZERO(set);
+	f = fopen(path, "r");
+	if(f == NULL)
+		return -1;
+	if(fgets(line, sizeof(line), f) == NULL) {
+		fclose(f);
+		return -1;
+	}
+	fclose(f);
+
+	for(token = strtok_r(line, ",\n", &last); token != NULL; token = strtok_r(NULL, ",\n", &last)) {
+		if(sscanf(token, "%d-%d", &from, &to) != 2) {
+			if(sscanf(token, "%d", &from) != 1)
+				continue;
+			to = from;
+		}
+		for(; from <= to && from < CPU_SETSIZE; ++from) {
+			CPU_SET(from, set);
+			++count;
+		}
+	}
+	return count;
+}
+
+static int linux_read_int(const char *path, int *value)
+{
+	FILE *f = fopen(path, "r");
+	int rv;
+
+	if(f == NULL)
+		return 0;
+	rv = fscanf(f, "%d", value) == 1;
+	fclose(f);
+	return rv;
+}
+
+int linux_get_numa_nodes()
+{
+	cpu_set_t nodes;
+	int count = linux_parse_list("/sys/devices/system/node/online", &nodes);
+
+	return count > 0 ? count : 1;
+}
+
+apr_status_t linux_bind_thread(int cpu, int node)
+{
+	cpu_set_t cpus;
+	char path[128];
+
+	if(cpu >= 0) {
+		CPU_ZERO(&cpus);
+		CPU_SET(cpu, &cpus);
+	} else if(node >= 0) {
+		snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+		if(linux_parse_list(path, &cpus) <= 0)
+			return APR_EGENERAL;
+	} else {
+		return APR_SUCCESS;
+	}
+
+	/* applies to the calling thread */
+	if(sched_setaffinity(0, sizeof(cpu_set_t), &cpus))
+		return APR_EGENERAL;
+
+	return APR_SUCCESS;
+}
+
+apr_status_t linux_bind_io_buffer(void *buf, uint64_t size, int node)
+{
+	unsigned long nodemask[16];
+
+	if(node < 0 || node >= (int) (sizeof(nodemask)*8))
+		return APR_EINVAL;
+
+	memset(nodemask, 0, sizeof(nodemask));
+	nodemask[node / (sizeof(unsigned long)*8)] = 1UL << (node % (sizeof(unsigned long)*8));
+
+	/* move pages already touched */
+	if(syscall(__NR_mbind, buf, size, MPOL_BIND, nodemask, sizeof(nodemask)*8, MPOL_MF_MOVE))
+		return APR_EGENERAL;
+
+	return APR_SUCCESS;
+}
+
+/*
+ * Find the NUMA node of the device behind a file through /sys/dev/block.
+ * Partitions and namespaces have the node on a parent device.
+ */
+apr_status_t linux_file_numa_node(struct platform_file *the_file, int *node)
+{
+	struct linux_platform_file *file = (struct linux_platform_file *) the_file;
+	static const char *candidates[] = {
+		"device/numa_node",
+		"device/device/numa_node",
+		"../device/numa_node",
+		"../device/device/numa_node",
+		NULL
+	};
+	const char **candidate;
+	struct stat filestat;
+	char path[256];
+	dev_t dev;
+
+	*node = -1;
+	if(fstat(file->fd, &filestat) < 0)
+		return APR_EGENERAL;
+
+	dev = S_ISBLK(filestat.st_mode) ? filestat.st_rdev : filestat.st_dev;
+	for(candidate = candidates; *candidate != NULL; ++candidate) {
+		snprintf(path, sizeof(path), "/sys/dev/block/%u:%u/%s", major(dev), minor(dev), *candidate);
+		if(linux_read_int(path, node) && *node >= 0)
+			return APR_SUCCESS;
+	}
+	*node = -1;
+	return APR_SUCCESS;
+}
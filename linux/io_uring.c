@@ -0,0 +1,369 @@
+/*
+  * io_uring.c
+  *
+  * Part of diskBench - IO bandwidth measurement
+  *
+  * Copyright (C) 2010-2011  Amund Elstad <amund.elstad@gmail.com>
+  *
+  *  This program is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *   the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  This program is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *   GNU General Public License for more details.
+  *
+  *   You should have received a copy of the GNU General Public License
+  *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+#include "linux.h"
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <errno.h>
+
+/*
+ * io_uring engine using the raw system calls, so no liburing is needed.
+ *
+ * Requests are only written to the submission ring by queue_read/queue_write.
+ * They are handed to the kernel in one io_uring_enter by queue_submit, or
+ * together with the wait for completions. The file is registered and the IO
+ * buffer slices of the queue are registered as fixed buffers when the kernel
+ * permits it.
+ */
+
+struct io_uring_platform_queue {
+	int ring_fd;
+
+	/* submission ring */
+	void *sq_ptr;
+	size_t sq_len;
+	unsigned *sq_head;
+	unsigned *sq_tail;
+	unsigned *sq_ring_mask;
+	unsigned *sq_flags;
+	unsigned *sq_array;
+	struct io_uring_sqe *sqes;
+	size_t sqes_len;
+
+	/* completion ring */
+	void *cq_ptr;
+	size_t cq_len;
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_ring_mask;
+	struct io_uring_cqe *cqes;
+
+	/* sqes written to the ring but not yet passed to io_uring_enter */
+	unsigned to_submit;
+
+	int sqpoll;
+	int iopoll;
+	int fixed_buffers;
+
+	/* one iovec per queue entry, used for buffer registration and readv/writev */
+	struct iovec *iovecs;
+	/* io_segments iovecs per queue entry in vectored mode */
+	struct iovec *segment_iovecs;
+	int segments;
+};
+
+static int io_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+	return (int) syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+	return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int io_uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args)
+{
+	return (int) syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static apr_status_t io_uring_map_rings(struct io_uring_platform_queue *q, struct io_uring_params *p)
+{
+	q->sq_len = p->sq_off.array + p->sq_entries * sizeof(unsigned);
+	q->cq_len = p->cq_off.cqes + p->cq_entries * sizeof(struct io_uring_cqe);
+
+	if(p->features & IORING_FEAT_SINGLE_MMAP) {
+		if(q->cq_len > q->sq_len)
+			q->sq_len = q->cq_len;
+		q->cq_len = q->sq_len;
+	}
+
+	q->sq_ptr = mmap(NULL, q->sq_len, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE,
+	                 q->ring_fd, IORING_OFF_SQ_RING);
+	if(q->sq_ptr == MAP_FAILED) {
+		q->sq_ptr = NULL;
+		return APR_EGENERAL;
+	}
+
+	if(p->features & IORING_FEAT_SINGLE_MMAP) {
+		q->cq_ptr = q->sq_ptr;
+	} else {
+		q->cq_ptr = mmap(NULL, q->cq_len, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE,
+		                 q->ring_fd, IORING_OFF_CQ_RING);
+		if(q->cq_ptr == MAP_FAILED) {
+			q->cq_ptr = NULL;
+			return APR_EGENERAL;
+		}
+	}
+
+	q->sq_head = q->sq_ptr + p->sq_off.head;
+	q->sq_tail = q->sq_ptr + p->sq_off.tail;
+	q->sq_ring_mask = q->sq_ptr + p->sq_off.ring_mask;
+	q->sq_flags = q->sq_ptr + p->sq_off.flags;
+	q->sq_array = q->sq_ptr + p->sq_off.array;
+
+	q->sqes_len = p->sq_entries * sizeof(struct io_uring_sqe);
+	q->sqes = mmap(NULL, q->sqes_len, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE,
+	               q->ring_fd, IORING_OFF_SQES);
+	if(q->sqes == MAP_FAILED) {
+		q->sqes = NULL;
+		return APR_EGENERAL;
+	}
+
+	q->cq_head = q->cq_ptr + p->cq_off.head;
+	q->cq_tail = q->cq_ptr + p->cq_off.tail;
+	q->cq_ring_mask = q->cq_ptr + p->cq_off.ring_mask;
+	q->cqes = q->cq_ptr + p->cq_off.cqes;
+
+	return APR_SUCCESS;
+}
+
+/* Unmap whatever io_uring_map_rings managed to map and close the ring */
+static void io_uring_unmap_rings(struct io_uring_platform_queue *q)
+{
+	if(q->sqes != NULL)
+		munmap(q->sqes, q->sqes_len);
+	if(q->cq_ptr != NULL && q->cq_ptr != q->sq_ptr)
+		munmap(q->cq_ptr, q->cq_len);
+	if(q->sq_ptr != NULL)
+		munmap(q->sq_ptr, q->sq_len);
+	close(q->ring_fd);
+}
+
+static apr_status_t io_uring_queue_create(struct async_queue *queue)
+{
+	struct io_uring_platform_queue *q;
+	struct io_uring_params params;
+	int fd = linux_file_fd(queue);
+	uint32_t i;
+
+	q = apr_pcalloc(queue->pool, sizeof(struct io_uring_platform_queue));
+	q->sqpoll = queue->workload->worker->options->sqpoll;
+	/* completion polling needs direct IO */
+	q->iopoll = queue->workload->worker->options->polled && !queue->workload->worker->options->buffered;
+
+	memset(&params, 0, sizeof(params));
+	if(q->iopoll)
+		params.flags |= IORING_SETUP_IOPOLL;
+	if(q->sqpoll) {
+		params.flags |= IORING_SETUP_SQPOLL;
+		params.sq_thread_idle = 1000;
+	}
+	q->ring_fd = io_uring_setup(queue->total, &params);
+	if(q->ring_fd < 0 && q->sqpoll) {
+		printf("io_uring: SQPOLL not permitted, falling back to normal submission\n");
+		q->sqpoll = 0;
+		/* start over from clean params, the failed setup may have written to them */
+		memset(&params, 0, sizeof(params));
+		if(q->iopoll)
+			params.flags |= IORING_SETUP_IOPOLL;
+		q->ring_fd = io_uring_setup(queue->total, &params);
+	}
+	if(q->ring_fd < 0)
+		return APR_EGENERAL;
+
+	if(io_uring_map_rings(q, &params) != APR_SUCCESS) {
+		io_uring_unmap_rings(q);
+		return APR_EGENERAL;
+	}
+
+	/* registered file is always index 0 */
+	if(io_uring_register(q->ring_fd, IORING_REGISTER_FILES, &fd, 1) < 0) {
+		io_uring_unmap_rings(q);
+		return APR_EGENERAL;
+	}
+
+	q->iovecs = apr_pcalloc(queue->pool, sizeof(struct iovec)*queue->total);
+	for(i=0; i < queue->total; ++i) {
+		q->iovecs[i].iov_base = queue->ioaqes[i].request.buf;
+		q->iovecs[i].iov_len = queue->ioaqes[i].request.bufsize;
+	}
+	/* may fail if RLIMIT_MEMLOCK is too low. Fall back to readv/writev */
+	q->fixed_buffers = io_uring_register(q->ring_fd, IORING_REGISTER_BUFFERS,
+	                                     q->iovecs, queue->total) == 0;
+
+	/* fixed buffers take a single range, vectored requests use readv/writev */
+	q->segments = queue->workload->worker->options->io_segments;
+	if(q->segments > 1) {
+		q->segment_iovecs = apr_pcalloc(queue->pool, sizeof(struct iovec)*queue->total*q->segments);
+	}
+
+	queue->platform_queue = (struct async_platform_queue*) q;
+	return APR_SUCCESS;
+}
+
+static apr_status_t io_uring_queue_destroy(struct async_queue *queue)
+{
+	struct io_uring_platform_queue *q = (struct io_uring_platform_queue*) queue->platform_queue;
+
+	io_uring_unmap_rings(q);
+
+	return APR_SUCCESS;
+}
+
+static struct io_uring_sqe *io_uring_get_sqe(struct io_uring_platform_queue *q)
+{
+	unsigned tail = *q->sq_tail;
+	unsigned index = tail & *q->sq_ring_mask;
+	struct io_uring_sqe *sqe = &(q->sqes[index]);
+
+	memset(sqe, 0, sizeof(struct io_uring_sqe));
+	q->sq_array[index] = index;
+	return sqe;
+}
+
+static void io_uring_commit_sqe(struct io_uring_platform_queue *q)
+{
+	/* publish sqe to the kernel */
+	__atomic_store_n(q->sq_tail, *q->sq_tail + 1, __ATOMIC_RELEASE);
+	q->to_submit = q->to_submit + 1;
+}
+
+static apr_status_t io_uring_queue_rw(struct async_queue *queue, struct async_queue_entry *ioop, int write)
+{
+	struct io_uring_platform_queue *q = (struct io_uring_platform_queue*) queue->platform_queue;
+	struct io_uring_sqe *sqe;
+	int i;
+
+	i = ioop - queue->ioaqes;
+	sqe = io_uring_get_sqe(q);
+
+	sqe->fd = 0;
+	sqe->flags = IOSQE_FIXED_FILE;
+	sqe->off = ioop->request.offset;
+	sqe->user_data = i;
+	if(q->segment_iovecs != NULL) {
+		sqe->opcode = write ? IORING_OP_WRITEV : IORING_OP_READV;
+		sqe->addr = (uint64_t) (uintptr_t) &(q->segment_iovecs[i*q->segments]);
+		sqe->len = linux_request_iovecs(&ioop->request, q->segments, queue->workload->worker->options->sector_size, &(q->segment_iovecs[i*q->segments]));
+	} else if(q->fixed_buffers) {
+		sqe->opcode = write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+		sqe->addr = (uint64_t) (uintptr_t) ioop->request.buf;
+		sqe->len = ioop->request.size;
+		sqe->buf_index = i;
+	} else {
+		q->iovecs[i].iov_base = ioop->request.buf;
+		q->iovecs[i].iov_len = ioop->request.size;
+		sqe->opcode = write ? IORING_OP_WRITEV : IORING_OP_READV;
+		sqe->addr = (uint64_t) (uintptr_t) &(q->iovecs[i]);
+		sqe->len = 1;
+	}
+
+	io_uring_commit_sqe(q);
+
+#ifdef DEBUG
+	printf("io_uring %s queued %"APR_UINT64_T_FMT "\n", write ? "write" : "read", (apr_uint64_t) ioop->request.size);
+#endif
+	return APR_SUCCESS;
+}
+
+static apr_status_t io_uring_queue_write(struct async_queue *queue, struct async_queue_entry *ioop)
+{
+	return io_uring_queue_rw(queue, ioop, 1);
+}
+
+static apr_status_t io_uring_queue_read(struct async_queue *queue, struct async_queue_entry *ioop)
+{
+	return io_uring_queue_rw(queue, ioop, 0);
+}
+
+/*
+ * Submit queued sqes and reap completions with a single io_uring_enter
+ */
+static apr_status_t io_uring_queue_wait(struct async_queue *queue, int min_events)
+{
+	struct io_uring_platform_queue *q = (struct io_uring_platform_queue*) queue->platform_queue;
+	struct io_uring_cqe *cqe;
+	unsigned flags = 0;
+	unsigned to_submit = q->to_submit;
+	unsigned head, tail;
+	apr_status_t rv = APR_SUCCESS;
+	int ret;
+
+	if(q->sqpoll) {
+		/* kernel thread picks up sqes, only wake it if it went idle */
+		to_submit = 0;
+		q->to_submit = 0;
+		if(__atomic_load_n(q->sq_flags, __ATOMIC_ACQUIRE) & IORING_SQ_NEED_WAKEUP)
+			flags |= IORING_ENTER_SQ_WAKEUP;
+	}
+	/* with IOPOLL completions are only found by polling from io_uring_enter */
+	if(min_events > 0 || q->iopoll)
+		flags |= IORING_ENTER_GETEVENTS;
+
+	if(to_submit > 0 || flags != 0) {
+		ret = io_uring_enter(q->ring_fd, to_submit, min_events, flags);
+		if(ret < 0) {
+			if(errno != EINTR && errno != EAGAIN && errno != EBUSY)
+				return APR_EGENERAL;
+		} else if(!q->sqpoll) {
+			q->to_submit -= ret;
+		}
+	}
+
+	head = *q->cq_head;
+	tail = __atomic_load_n(q->cq_tail, __ATOMIC_ACQUIRE);
+	while(head != tail) {
+		cqe = &(q->cqes[head & *q->cq_ring_mask]);
+		if(cqe->res < 0)
+			rv = APR_EGENERAL;
+
+		/* notify */
+		generic_queue_notify(queue, &(queue->ioaqes[cqe->user_data]));
+		++head;
+	}
+	__atomic_store_n(q->cq_head, head, __ATOMIC_RELEASE);
+
+	return rv;
+}
+
+static apr_status_t io_uring_queue_submit(struct async_queue *queue)
+{
+	/* submission without waiting */
+	return io_uring_queue_wait(queue, 0);
+}
+
+struct platform_ops linux_io_uring_platform_ops = {
+	&linux_create_io_buffer,
+	&linux_get_pagesize,
+	&linux_get_min_io_size,
+	&linux_get_io_counters,
+	&linux_get_cpu_time,
+	&linux_get_numa_nodes,
+	&linux_bind_thread,
+	&linux_bind_io_buffer,
+	&linux_file_open,
+	&linux_file_truncate,
+	&linux_file_close,
+	&linux_file_flush,
+	&linux_file_datasync,
+	&linux_file_evict,
+	&linux_file_discard,
+	&linux_file_numa_node,
+	&io_uring_queue_create,
+	&io_uring_queue_destroy,
+	&io_uring_queue_read,
+	&io_uring_queue_write,
+	&io_uring_queue_wait,
+	&io_uring_queue_submit,
+	"io_uring"
+};
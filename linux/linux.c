@@ -18,42 +18,167 @@
   *   You should have received a copy of the GNU General Public License
   *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
   */
-#include "diskBench.h"
+#include "linux.h"
 #include <libaio.h>
 #include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/statvfs.h>
+#include <sys/resource.h>
 #include <fcntl.h>
-
-struct linux_platform_file {
-	int fd;
-};
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include <linux/falloc.h>
 
 struct linux_platform_queue {
 	struct iocb *iocbs;
 	struct io_event *events;
 	io_context_t ctxp;
+
+	/* iocbs prepared since last io_submit */
+	struct iocb **pending;
+	long npending;
+
+	/* io_segments iovecs per queue entry in vectored mode */
+	struct iovec *iovecs;
 };
 
 
-static apr_size_t linux_get_pagesize() {
+apr_size_t linux_get_pagesize() {
 	return sysconf(_SC_PAGESIZE);
 }
 
-static apr_size_t linux_get_min_io_size() {
+apr_size_t linux_get_min_io_size() {
     return 512;
 }
 
-static apr_status_t linux_create_io_buffer(void **buf, uint64_t size)
+/* Storage level counters from /proc/self/io. Cover all threads of the process */
+apr_status_t linux_get_io_counters(uint64_t *read_bytes, uint64_t *write_bytes)
+{
+	FILE *f;
+	char line[128];
+	unsigned long long value;
+
+	*read_bytes = 0;
+	*write_bytes = 0;
+	f = fopen("/proc/self/io", "r");
+	if(f == NULL)
+		return APR_EGENERAL;
+
+	while(fgets(line, sizeof(line), f) != NULL) {
+		if(sscanf(line, "read_bytes: %llu", &value) == 1)
+			*read_bytes = value;
+		else if(sscanf(line, "write_bytes: %llu", &value) == 1)
+			*write_bytes = value;
+	}
+	fclose(f);
+	return APR_SUCCESS;
+}
+
+apr_status_t linux_get_cpu_time(apr_time_t *cpu_time)
 {
-    *buf = mmap(NULL,size,PROT_READ|PROT_WRITE,MAP_ANONYMOUS|MAP_PRIVATE,-1,0);
+	struct rusage usage;
+
+	if(getrusage(RUSAGE_SELF, &usage))
+		return APR_EGENERAL;
+
+	*cpu_time = apr_time_from_sec(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec)
+		+ usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+	return APR_SUCCESS;
+}
+
+#define HUGE_PAGE_SIZE (2*1024*1024)
+
+/*
+ * Anonymous IO buffer. Explicit huge pages come from the hugetlbfs pool and
+ * fall back to normal pages when the pool is empty. Transparent huge pages
+ * must be advised before the first touch, so prefaulting is done by hand then.
+ */
+apr_status_t linux_create_io_buffer(void **buf, uint64_t size, int flags, int *used_flags)
+{
+    int mmap_flags = MAP_ANONYMOUS|MAP_PRIVATE;
+    uint64_t i;
+
+    *used_flags = 0;
+    *buf = MAP_FAILED;
+    if(flags & IO_BUFFER_POPULATE && !(flags & IO_BUFFER_THP))
+        mmap_flags |= MAP_POPULATE;
+
+    if(flags & IO_BUFFER_HUGETLB) {
+        *buf = mmap(NULL, (size + HUGE_PAGE_SIZE - 1) & ~((uint64_t) HUGE_PAGE_SIZE - 1),
+                    PROT_READ|PROT_WRITE, mmap_flags|MAP_HUGETLB, -1, 0);
+        if(*buf != MAP_FAILED) {
+            *used_flags |= IO_BUFFER_HUGETLB;
+        } else {
+            printf("No huge pages available (see /proc/sys/vm/nr_hugepages), using normal pages\n");
+        }
+    }
+    if(*buf == MAP_FAILED) {
+        *buf = mmap(NULL, size, PROT_READ|PROT_WRITE, mmap_flags, -1, 0);
+        if(*buf == MAP_FAILED)
+            return APR_ENOMEM;
+    }
+
+#ifdef MADV_HUGEPAGE
+    if((flags & IO_BUFFER_THP) && !(*used_flags & IO_BUFFER_HUGETLB)
+            && madvise(*buf, size, MADV_HUGEPAGE) == 0) {
+        *used_flags |= IO_BUFFER_THP;
+    }
+#endif
+    if(flags & IO_BUFFER_POPULATE) {
+        if(!(mmap_flags & MAP_POPULATE)) {
+            for(i=0; i < size; i += linux_get_pagesize())
+                ((volatile char *) *buf)[i] = 0;
+        }
+        *used_flags |= IO_BUFFER_POPULATE;
+    }
+    if(flags & IO_BUFFER_LOCK) {
+        if(mlock(*buf, size) == 0) {
+            *used_flags |= IO_BUFFER_LOCK;
+        } else {
+            printf("Could not lock IO buffer (see ulimit -l)\n");
+        }
+    }
 
     return APR_SUCCESS;
 }
 
-static apr_status_t linux_file_open(char *filename, uint64_t *length, double freespace_percentage,
-                                    int *file_truncated, struct platform_file **rv)
+/*
+ * Split the buffer of a request into at most segments iovecs. Segments are
+ * multiples of the sector size so they are valid for direct IO, the last
+ * one takes the remainder. Requests too small to split are one segment.
+ * Returns the number of iovecs.
+ */
+int linux_request_iovecs(struct io_request *request, int segments, uint64_t sector_size, struct iovec *iov)
+{
+    uint64_t segsize;
+    uint64_t done = 0;
+    int n = 0;
+
+    if(request->size < segments * sector_size) {
+        iov[0].iov_base = request->buf;
+        iov[0].iov_len = request->size;
+        return 1;
+    }
+    segsize = request->size / segments;
+    segsize = segsize - segsize % sector_size;
+
+    while(done < request->size) {
+        iov[n].iov_base = (char *) request->buf + done;
+        if(n == segments - 1 || request->size - done < segsize) {
+            iov[n].iov_len = request->size - done;
+        } else {
+            iov[n].iov_len = segsize;
+        }
+        done += iov[n].iov_len;
+        ++n;
+    }
+    return n;
+}
+
+apr_status_t linux_file_open(char *filename, int buffered, uint64_t *length, double freespace_percentage,
+                             int *file_truncated, struct platform_file **rv)
 {
 	struct linux_platform_file *file;
 	int fd;
@@ -114,8 +239,8 @@ static apr_status_t linux_file_open(char *filename, uint64_t *length, double fre
 		fallocate(fd,0,0,*length);
 	}
 	close(fd);
-	/* Open in O_DIRECT mode */
-        fd = open(filename, O_DIRECT|O_RDWR, S_IRUSR|S_IWUSR);
+	/* Open in O_DIRECT mode unless the page cache is tested */
+	fd = open(filename, (buffered ? 0 : O_DIRECT)|O_RDWR, S_IRUSR|S_IWUSR);
 	
 	file = malloc(sizeof(struct linux_platform_file));
 	file->fd = fd;
@@ -124,7 +249,7 @@ static apr_status_t linux_file_open(char *filename, uint64_t *length, double fre
 	return APR_SUCCESS;
 }
 
-static apr_status_t linux_file_truncate(struct platform_file *the_file, uint64_t *length)
+apr_status_t linux_file_truncate(struct platform_file *the_file, uint64_t *length)
 {
 	struct linux_platform_file *file = (struct linux_platform_file *) the_file;
 	if(ftruncate(file->fd, *length)) {
@@ -133,7 +258,7 @@ static apr_status_t linux_file_truncate(struct platform_file *the_file, uint64_t
 	return APR_SUCCESS;
 }
 
-static apr_status_t linux_file_close(struct platform_file *the_file)
+apr_status_t linux_file_close(struct platform_file *the_file)
 {
 	struct linux_platform_file *file = (struct linux_platform_file *) the_file;
 	if(close(file->fd))
@@ -144,7 +269,7 @@ static apr_status_t linux_file_close(struct platform_file *the_file)
 	return APR_SUCCESS;
 }
 
-static apr_status_t linux_file_flush(struct platform_file *the_file)
+apr_status_t linux_file_flush(struct platform_file *the_file)
 {
 	struct linux_platform_file *file = (struct linux_platform_file *) the_file;
 	if(fsync(file->fd))
@@ -153,6 +278,51 @@ static apr_status_t linux_file_flush(struct platform_file *the_file)
 	return APR_SUCCESS;
 }
 
+apr_status_t linux_file_datasync(struct platform_file *the_file)
+{
+	struct linux_platform_file *file = (struct linux_platform_file *) the_file;
+	if(fdatasync(file->fd))
+		return APR_EGENERAL;
+
+	return APR_SUCCESS;
+}
+
+apr_status_t linux_file_evict(struct platform_file *the_file)
+{
+	struct linux_platform_file *file = (struct linux_platform_file *) the_file;
+
+	/* dirty pages are not dropped */
+	if(fdatasync(file->fd))
+		return APR_EGENERAL;
+
+	if(posix_fadvise(file->fd, 0, 0, POSIX_FADV_DONTNEED))
+		return APR_EGENERAL;
+
+	return APR_SUCCESS;
+}
+
+apr_status_t linux_file_discard(struct platform_file *the_file, uint64_t offset, uint64_t length)
+{
+	struct linux_platform_file *file = (struct linux_platform_file *) the_file;
+	struct stat filestat;
+	uint64_t range[2];
+
+	if(fstat(file->fd, &filestat) < 0)
+		return APR_EGENERAL;
+
+	if(S_ISBLK(filestat.st_mode)) {
+		range[0] = offset;
+		range[1] = length;
+		if(ioctl(file->fd, BLKDISCARD, &range))
+			return errno == EOPNOTSUPP ? APR_ENOTIMPL : APR_EGENERAL;
+	} else {
+		if(fallocate(file->fd, FALLOC_FL_PUNCH_HOLE|FALLOC_FL_KEEP_SIZE, offset, length))
+			return errno == EOPNOTSUPP ? APR_ENOTIMPL : APR_EGENERAL;
+	}
+
+	return APR_SUCCESS;
+}
+
 static apr_status_t linux_queue_create(struct async_queue *queue)
 {
 	struct linux_platform_queue *q;
@@ -163,6 +333,12 @@ static apr_status_t linux_queue_create(struct async_queue *queue)
 	}
 	q->iocbs = apr_pcalloc(queue->pool, sizeof(struct iocb)*queue->total);
 	q->events = apr_pcalloc(queue->pool, sizeof(struct io_event)*queue->total);
+	q->pending = apr_pcalloc(queue->pool, sizeof(struct iocb*)*queue->total);
+	q->npending = 0;
+	if(queue->workload->worker->options->io_segments > 1) {
+		q->iovecs = apr_pcalloc(queue->pool,
+			sizeof(struct iovec)*queue->total*queue->workload->worker->options->io_segments);
+	}
 
 
 	queue->platform_queue = (struct async_platform_queue*) q;
@@ -181,87 +357,159 @@ static apr_status_t linux_queue_destroy(struct async_queue *queue)
 static apr_status_t linux_queue_write(struct async_queue *queue, struct async_queue_entry *ioop)
 {
 	struct linux_platform_queue *q = (struct linux_platform_queue*) queue->platform_queue;
-	struct iocb *event[1];
 	struct iocb *iocb;
+	struct iovec *iov;
+	int segments;
 	int i;
 
 	i = ioop - queue->ioaqes;
 	iocb = &(q->iocbs[i]);
 
-    io_prep_pwrite(iocb,((struct linux_platform_file *)queue->workload->worker->file)->fd,
-                   ioop->request.buf,
-                   ioop->request.size, ioop->request.offset);
+    if(q->iovecs != NULL) {
+        segments = queue->workload->worker->options->io_segments;
+        iov = &(q->iovecs[i*segments]);
+        io_prep_pwritev(iocb, linux_file_fd(queue), iov,
+                        linux_request_iovecs(&ioop->request, segments, queue->workload->worker->options->sector_size, iov),
+                        ioop->request.offset);
+    } else {
+        io_prep_pwrite(iocb,((struct linux_platform_file *)queue->workload->worker->file)->fd,
+                       ioop->request.buf,
+                       ioop->request.size, ioop->request.offset);
+    }
 
 #ifdef DEBUG
 	printf("Write submitted %d\n",iocb->u.c.nbytes);
 #endif
 
 
-	event[0] = iocb;
-	return io_submit(q->ctxp, 1, event) == 1 ? APR_SUCCESS : APR_EGENERAL;
+	q->pending[q->npending++] = iocb;
+	return APR_SUCCESS;
 }
 
 
 static apr_status_t linux_queue_read(struct async_queue *queue, struct async_queue_entry *ioop)
 {
 	struct linux_platform_queue *q = (struct linux_platform_queue*) queue->platform_queue;
-	struct iocb *event[1];
 	struct iocb *iocb;
+	struct iovec *iov;
+	int segments;
 	int i;
 
 	i = ioop - queue->ioaqes;
 	iocb = &(q->iocbs[i]);
 
-    io_prep_pread(iocb,
-                  ((struct linux_platform_file *)queue->workload->worker->file)->fd,
-                   ioop->request.buf,
-                   ioop->request.size, ioop->request.offset
-                  );
+    if(q->iovecs != NULL) {
+        segments = queue->workload->worker->options->io_segments;
+        iov = &(q->iovecs[i*segments]);
+        io_prep_preadv(iocb, linux_file_fd(queue), iov,
+                       linux_request_iovecs(&ioop->request, segments, queue->workload->worker->options->sector_size, iov),
+                       ioop->request.offset);
+    } else {
+        io_prep_pread(iocb,
+                      ((struct linux_platform_file *)queue->workload->worker->file)->fd,
+                       ioop->request.buf,
+                       ioop->request.size, ioop->request.offset
+                      );
+    }
 
 #ifdef DEBUG
 	printf("Read sumbitted\n");
 #endif
 
-	event[0] = iocb;
-	return io_submit(q->ctxp, 1, event) == 1 ? APR_SUCCESS : APR_EGENERAL;
+	q->pending[q->npending++] = iocb;
+	return APR_SUCCESS;
+}
+
+/* Submit all prepared iocbs with as few io_submit calls as possible */
+static apr_status_t linux_queue_submit(struct async_queue *queue)
+{
+	struct linux_platform_queue *q = (struct linux_platform_queue*) queue->platform_queue;
+	long submitted = 0;
+	int tmp;
+
+	while(submitted < q->npending) {
+		tmp = io_submit(q->ctxp, q->npending - submitted, q->pending + submitted);
+		if(tmp <= 0)
+			return APR_EGENERAL;
+		submitted += tmp;
+	}
+	q->npending = 0;
+	return APR_SUCCESS;
 }
 
-static apr_status_t linux_queue_wait(struct async_queue *queue, int block)
+static apr_status_t linux_queue_wait(struct async_queue *queue, int min_events)
 {
 	struct linux_platform_queue *q = (struct linux_platform_queue*) queue->platform_queue;
 	struct io_event *ioe;
 	struct async_queue_entry *ioop;
-	struct timespec ts;
+	int polled = queue->workload->worker->options->polled;
 
 	int i,j;
 	long tmp;
+	long reaped = 0;
 
+	do {
+		/* polled mode spins on non-blocking io_getevents instead of sleeping in the kernel */
+		tmp = io_getevents(q->ctxp, polled ? 0 : min_events - reaped, queue->active, q->events, NULL);
+		if(tmp < 0)
+			return APR_EGENERAL;
 
-	tmp = io_getevents(q->ctxp, block ? 1 : 0, queue->active, q->events, NULL);
-	for(i=0; i < tmp; ++i) {
-		ioe = &(q->events)[i];
-		j = ioe->obj - q->iocbs;
-		ioop = &(queue->ioaqes[j]);
+		for(i=0; i < tmp; ++i) {
+			ioe = &(q->events)[i];
+			j = ioe->obj - q->iocbs;
+			ioop = &(queue->ioaqes[j]);
 
-		/* notify */
-		generic_queue_notify(queue, ioop);
-	}
-	return (tmp < 0) ? APR_EGENERAL : APR_SUCCESS;
+			/* notify */
+			generic_queue_notify(queue, ioop);
+		}
+		reaped += tmp;
+	} while(reaped < min_events);
+
+	return APR_SUCCESS;
 }
 
 static struct platform_ops linux_platform_ops = {
     &linux_create_io_buffer,
 	&linux_get_pagesize,
     &linux_get_min_io_size,
+	&linux_get_io_counters,
+	&linux_get_cpu_time,
+	&linux_get_numa_nodes,
+	&linux_bind_thread,
+	&linux_bind_io_buffer,
 	&linux_file_open,
 	&linux_file_truncate,
 	&linux_file_close,
 	&linux_file_flush,
+	&linux_file_datasync,
+	&linux_file_evict,
+	&linux_file_discard,
+	&linux_file_numa_node,
 	&linux_queue_create,
 	&linux_queue_destroy,
 	&linux_queue_read,
 	&linux_queue_write,
-	&linux_queue_wait
+	&linux_queue_wait,
+	&linux_queue_submit,
+	"libaio"
 };
 
 struct platform_ops *platform_ops = &linux_platform_ops;
+
+static struct platform_ops *linux_engines[] = {
+	&linux_platform_ops,
+	&linux_io_uring_platform_ops,
+	&linux_psync_platform_ops,
+	&linux_mmap_platform_ops,
+	NULL
+};
+
+struct platform_ops *platform_ops_lookup(const char *name)
+{
+	struct platform_ops **ops;
+	for(ops = linux_engines; *ops != NULL; ++ops) {
+		if(strcmp((*ops)->name, name) == 0)
+			return *ops;
+	}
+	return NULL;
+}
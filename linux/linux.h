@@ -0,0 +1,74 @@
+#ifndef LINUX_H_
+#define LINUX_H_
+
+/*
+ * linux.h
+ *
+ * Part of diskBench - IO bandwidth measurement
+ *
+ * Copyright (C) 2010-2011  Amund Elstad <amund.elstad@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "diskBench.h"
+#include <sys/uio.h>
+
+/*
+ * Shared between the linux IO engines. The file handling is common,
+ * only the queue implementation differs between engines.
+ */
+struct linux_platform_file {
+	int fd;
+};
+
+static inline int linux_file_fd(struct async_queue *queue)
+{
+    return ((struct linux_platform_file *) queue->workload->worker->file)->fd;
+}
+
+apr_size_t linux_get_pagesize();
+apr_size_t linux_get_min_io_size();
+apr_status_t linux_get_io_counters(uint64_t *read_bytes, uint64_t *write_bytes);
+apr_status_t linux_get_cpu_time(apr_time_t *cpu_time);
+
+apr_status_t linux_create_io_buffer(void **buf, uint64_t size, int flags, int *used_flags);
+
+int linux_request_iovecs(struct io_request *request, int segments, uint64_t sector_size, struct iovec *iov);
+
+apr_status_t linux_file_open(char *filename, int buffered, uint64_t *length, double freespace_percentage,
+                             int *file_truncated, struct platform_file **rv);
+apr_status_t linux_file_truncate(struct platform_file *the_file, uint64_t *length);
+apr_status_t linux_file_close(struct platform_file *the_file);
+apr_status_t linux_file_flush(struct platform_file *the_file);
+apr_status_t linux_file_datasync(struct platform_file *the_file);
+apr_status_t linux_file_evict(struct platform_file *the_file);
+apr_status_t linux_file_discard(struct platform_file *the_file, uint64_t offset, uint64_t length);
+
+/* CPU and NUMA placement, see affinity.c */
+int linux_get_numa_nodes();
+apr_status_t linux_bind_thread(int cpu, int node);
+apr_status_t linux_bind_io_buffer(void *buf, uint64_t size, int node);
+apr_status_t linux_file_numa_node(struct platform_file *the_file, int *node);
+
+/* io_uring engine, see io_uring.c */
+extern struct platform_ops linux_io_uring_platform_ops;
+
+/* pread/pwrite thread pool engine, see psync.c */
+extern struct platform_ops linux_psync_platform_ops;
+
+/* memory mapped engine, see mmap.c */
+extern struct platform_ops linux_mmap_platform_ops;
+
+#endif /*LINUX_H_*/
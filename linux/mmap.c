@@ -0,0 +1,238 @@
+/*
+  * mmap.c
+  *
+  * Part of diskBench - IO bandwidth measurement
+  *
+  * Copyright (C) 2010-2011  Amund Elstad <amund.elstad@gmail.com>
+  *
+  *  This program is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *   the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  This program is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *   GNU General Public License for more details.
+  *
+  *   You should have received a copy of the GNU General Public License
+  *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+#include "linux.h"
+#include <sys/mman.h>
+
+/*
+ * Memory mapped engine. The whole file is mapped shared and reads/writes are
+ * copies from/to the mapping, so the IO is done by page faults and writeback.
+ * Every request completes before queue_read/queue_write returns. Use several
+ * files or threads to get parallel faults.
+ */
+
+struct mmap_platform_file {
+	/* must be first, the file is also used as a linux_platform_file */
+	struct linux_platform_file base;
+
+	char *map;
+	uint64_t length;
+};
+
+struct mmap_platform_queue {
+	struct async_ioop_ring completed;
+};
+
+static apr_status_t mmap_map(struct mmap_platform_file *file, uint64_t length)
+{
+	file->length = length;
+	file->map = NULL;
+	if(length == 0)
+		return APR_SUCCESS;
+
+	file->map = mmap(NULL, length, PROT_READ|PROT_WRITE, MAP_SHARED, file->base.fd, 0);
+	if(file->map == MAP_FAILED) {
+		file->map = NULL;
+		return APR_EGENERAL;
+	}
+	return APR_SUCCESS;
+}
+
+static void mmap_unmap(struct mmap_platform_file *file)
+{
+	if(file->map != NULL)
+		munmap(file->map, file->length);
+	file->map = NULL;
+}
+
+static apr_status_t mmap_file_open(char *filename, int buffered, uint64_t *length, double freespace_percentage,
+                                   int *file_truncated, struct platform_file **rv)
+{
+	struct platform_file *the_file;
+	struct mmap_platform_file *file;
+	apr_status_t status;
+
+	*rv = NULL;
+	/* mappings always go through the page cache */
+	status = linux_file_open(filename, 1, length, freespace_percentage, file_truncated, &the_file);
+	if(status != APR_SUCCESS)
+		return status;
+
+	file = calloc(1, sizeof(struct mmap_platform_file));
+	file->base.fd = ((struct linux_platform_file *) the_file)->fd;
+	free(the_file);
+
+	status = mmap_map(file, *length);
+	if(status != APR_SUCCESS)
+		return status;
+
+	*rv = (struct platform_file*) file;
+	return APR_SUCCESS;
+}
+
+static apr_status_t mmap_file_truncate(struct platform_file *the_file, uint64_t *length)
+{
+	struct mmap_platform_file *file = (struct mmap_platform_file *) the_file;
+	apr_status_t status;
+
+	mmap_unmap(file);
+	status = linux_file_truncate(the_file, length);
+	if(status != APR_SUCCESS)
+		return status;
+
+	return mmap_map(file, *length);
+}
+
+static apr_status_t mmap_file_close(struct platform_file *the_file)
+{
+	mmap_unmap((struct mmap_platform_file *) the_file);
+	return linux_file_close(the_file);
+}
+
+static apr_status_t mmap_file_flush(struct platform_file *the_file)
+{
+	struct mmap_platform_file *file = (struct mmap_platform_file *) the_file;
+
+	if(file->map != NULL && msync(file->map, file->length, MS_SYNC))
+		return APR_EGENERAL;
+
+	return APR_SUCCESS;
+}
+
+static apr_status_t mmap_file_evict(struct platform_file *the_file)
+{
+	struct mmap_platform_file *file = (struct mmap_platform_file *) the_file;
+	apr_status_t status;
+
+	status = mmap_file_flush(the_file);
+	if(status != APR_SUCCESS)
+		return status;
+
+	/* unmap pages from this process so the page cache can drop them */
+	if(file->map != NULL && madvise(file->map, file->length, MADV_DONTNEED))
+		return APR_EGENERAL;
+
+	return linux_file_evict(the_file);
+}
+
+static apr_status_t mmap_queue_create(struct async_queue *queue)
+{
+	struct mmap_platform_queue *q;
+	struct mmap_platform_file *file = (struct mmap_platform_file *) queue->workload->worker->file;
+	int advice = queue->workload->worker->options->map_advice;
+
+	q = apr_pcalloc(queue->pool, sizeof(struct mmap_platform_queue));
+	APR_RING_INIT(&q->completed, async_queue_entry, link);
+	queue->platform_queue = (struct async_platform_queue*) q;
+
+	if(file->map == NULL)
+		return APR_EGENERAL;
+
+	/* madvise policy applies to the next test */
+	if(madvise(file->map, file->length, MADV_NORMAL))
+		return APR_EGENERAL;
+	if((advice & MAP_ADVICE_SEQUENTIAL) && madvise(file->map, file->length, MADV_SEQUENTIAL))
+		return APR_EGENERAL;
+	if((advice & MAP_ADVICE_RANDOM) && madvise(file->map, file->length, MADV_RANDOM))
+		return APR_EGENERAL;
+#ifdef MADV_HUGEPAGE
+	/* not supported by all filesystems, ignore failure */
+	if(advice & MAP_ADVICE_HUGEPAGE)
+		madvise(file->map, file->length, MADV_HUGEPAGE);
+#endif
+
+	return APR_SUCCESS;
+}
+
+static apr_status_t mmap_queue_destroy(struct async_queue *queue)
+{
+	return APR_SUCCESS;
+}
+
+static apr_status_t mmap_queue_write(struct async_queue *queue, struct async_queue_entry *ioop)
+{
+	struct mmap_platform_queue *q = (struct mmap_platform_queue*) queue->platform_queue;
+	struct mmap_platform_file *file = (struct mmap_platform_file *) queue->workload->worker->file;
+
+	if(ioop->request.offset + ioop->request.size > file->length)
+		return APR_EGENERAL;
+
+	memcpy(file->map + ioop->request.offset, ioop->request.buf, ioop->request.size);
+	APR_RING_INSERT_TAIL(&q->completed, ioop, async_queue_entry, link);
+
+	return APR_SUCCESS;
+}
+
+static apr_status_t mmap_queue_read(struct async_queue *queue, struct async_queue_entry *ioop)
+{
+	struct mmap_platform_queue *q = (struct mmap_platform_queue*) queue->platform_queue;
+	struct mmap_platform_file *file = (struct mmap_platform_file *) queue->workload->worker->file;
+
+	if(ioop->request.offset + ioop->request.size > file->length)
+		return APR_EGENERAL;
+
+	memcpy(ioop->request.buf, file->map + ioop->request.offset, ioop->request.size);
+	APR_RING_INSERT_TAIL(&q->completed, ioop, async_queue_entry, link);
+
+	return APR_SUCCESS;
+}
+
+static apr_status_t mmap_queue_wait(struct async_queue *queue, int min_events)
+{
+	struct mmap_platform_queue *q = (struct mmap_platform_queue*) queue->platform_queue;
+	struct async_queue_entry *ioop;
+
+	/* everything queued has completed */
+	while(!APR_RING_EMPTY(&q->completed, async_queue_entry, link)) {
+		ioop = APR_RING_FIRST(&q->completed);
+		APR_RING_REMOVE(ioop, link);
+
+		/* notify */
+		generic_queue_notify(queue, ioop);
+	}
+	return APR_SUCCESS;
+}
+
+struct platform_ops linux_mmap_platform_ops = {
+	&linux_create_io_buffer,
+	&linux_get_pagesize,
+	&linux_get_min_io_size,
+	&linux_get_io_counters,
+	&linux_get_cpu_time,
+	&linux_get_numa_nodes,
+	&linux_bind_thread,
+	&linux_bind_io_buffer,
+	&mmap_file_open,
+	&mmap_file_truncate,
+	&mmap_file_close,
+	&mmap_file_flush,
+	/* msync writes back data only */
+	&mmap_file_flush,
+	&mmap_file_evict,
+	&linux_file_discard,
+	&linux_file_numa_node,
+	&mmap_queue_create,
+	&mmap_queue_destroy,
+	&mmap_queue_read,
+	&mmap_queue_write,
+	&mmap_queue_wait,
+	NULL,
+	"mmap"
+};
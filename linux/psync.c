@@ -0,0 +1,246 @@
+/*
+  * psync.c
+  *
+  * Part of diskBench - IO bandwidth measurement
+  *
+  * Copyright (C) 2010-2011  Amund Elstad <amund.elstad@gmail.com>
+  *
+  *  This program is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *   the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  This program is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *   GNU General Public License for more details.
+  *
+  *   You should have received a copy of the GNU General Public License
+  *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+#include "linux.h"
+#include "apr_thread_mutex.h"
+#include <sys/uio.h>
+
+/*
+ * Synchronous pread/pwrite engine (preadv2/pwritev2 with RWF_HIPRI in polled mode). Each queue owns one thread per queue entry,
+ * which is how applications doing blocking IO from a thread pool see the device.
+ *
+ * Queue entries move between three rings: staged (owned by the ioworker),
+ * submitted (picked up by pool threads) and completed (reaped by queue_wait).
+ * Completions are always delivered through generic_queue_notify on the
+ * ioworker thread.
+ */
+
+struct psync_platform_queue {
+	struct async_queue *queue;
+
+	apr_thread_mutex_t *mutex;
+	apr_thread_cond_t *submitted_cond;
+	apr_thread_cond_t *completed_cond;
+
+	struct async_ioop_ring staged;
+	struct async_ioop_ring submitted;
+	struct async_ioop_ring completed;
+
+	uint32_t completed_count;
+	int shutdown;
+	int error;
+
+	apr_thread_t **threads;
+};
+
+static apr_status_t psync_do_io(int fd, struct io_request *request, int polled, int segments, uint64_t sector_size)
+{
+	uint64_t done = 0;
+	ssize_t tmp;
+	struct iovec iov[MAX_IO_SEGMENTS];
+	int iovcnt;
+	/* RWF_HIPRI makes the kernel poll for completion of direct IO */
+	int flags = polled ? RWF_HIPRI : 0;
+
+	while(done < request->size) {
+		if(done == 0 && segments > 1) {
+			iovcnt = linux_request_iovecs(request, segments, sector_size, iov);
+		} else {
+			/* segments are contiguous, a short transfer is completed in one piece */
+			iov[0].iov_base = (char *) request->buf + done;
+			iov[0].iov_len = request->size - done;
+			iovcnt = 1;
+		}
+		if(request->write) {
+			tmp = pwritev2(fd, iov, iovcnt, request->offset + done, flags);
+		} else {
+			tmp = preadv2(fd, iov, iovcnt, request->offset + done, flags);
+		}
+		if(tmp <= 0)
+			return APR_EGENERAL;
+		done += tmp;
+	}
+	return APR_SUCCESS;
+}
+
+static void *APR_THREAD_FUNC psync_thread(apr_thread_t *thd, void *data)
+{
+	struct psync_platform_queue *q = (struct psync_platform_queue *) data;
+	struct async_queue_entry *ioop;
+	int fd = linux_file_fd(q->queue);
+	int polled = q->queue->workload->worker->options->polled;
+	int segments = q->queue->workload->worker->options->io_segments;
+	uint64_t sector_size = q->queue->workload->worker->options->sector_size;
+	apr_status_t rv;
+
+	apr_thread_mutex_lock(q->mutex);
+	for(;;) {
+		while(!q->shutdown && APR_RING_EMPTY(&q->submitted, async_queue_entry, link)) {
+			apr_thread_cond_wait(q->submitted_cond, q->mutex);
+		}
+		if(q->shutdown)
+			break;
+
+		ioop = APR_RING_FIRST(&q->submitted);
+		APR_RING_REMOVE(ioop, link);
+		apr_thread_mutex_unlock(q->mutex);
+
+		rv = psync_do_io(fd, &ioop->request, polled, segments, sector_size);
+
+		apr_thread_mutex_lock(q->mutex);
+		if(rv != APR_SUCCESS)
+			q->error = 1;
+		APR_RING_INSERT_TAIL(&q->completed, ioop, async_queue_entry, link);
+		q->completed_count = q->completed_count + 1;
+		apr_thread_cond_signal(q->completed_cond);
+	}
+	apr_thread_mutex_unlock(q->mutex);
+
+	apr_thread_exit(thd, APR_SUCCESS);
+	return NULL;
+}
+
+static apr_status_t psync_queue_create(struct async_queue *queue)
+{
+	struct psync_platform_queue *q;
+	apr_status_t rv;
+	uint32_t i;
+
+	q = apr_pcalloc(queue->pool, sizeof(struct psync_platform_queue));
+	q->queue = queue;
+	APR_RING_INIT(&q->staged, async_queue_entry, link);
+	APR_RING_INIT(&q->submitted, async_queue_entry, link);
+	APR_RING_INIT(&q->completed, async_queue_entry, link);
+
+	rv = apr_thread_mutex_create(&q->mutex, APR_THREAD_MUTEX_DEFAULT, queue->pool);
+	if(rv != APR_SUCCESS)
+		return rv;
+	rv = apr_thread_cond_create(&q->submitted_cond, queue->pool);
+	if(rv != APR_SUCCESS)
+		return rv;
+	rv = apr_thread_cond_create(&q->completed_cond, queue->pool);
+	if(rv != APR_SUCCESS)
+		return rv;
+
+	queue->platform_queue = (struct async_platform_queue*) q;
+
+	q->threads = apr_pcalloc(queue->pool, sizeof(apr_thread_t*)*queue->total);
+	for(i=0; i < queue->total; ++i) {
+		rv = apr_thread_create(&(q->threads[i]), NULL, psync_thread, q, queue->pool);
+		if(rv != APR_SUCCESS)
+			return rv;
+	}
+	return APR_SUCCESS;
+}
+
+static apr_status_t psync_queue_destroy(struct async_queue *queue)
+{
+	struct psync_platform_queue *q = (struct psync_platform_queue*) queue->platform_queue;
+	apr_status_t rv;
+	uint32_t i;
+
+	apr_thread_mutex_lock(q->mutex);
+	q->shutdown = 1;
+	apr_thread_cond_broadcast(q->submitted_cond);
+	apr_thread_mutex_unlock(q->mutex);
+
+	for(i=0; i < queue->total; ++i) {
+		apr_thread_join(&rv, q->threads[i]);
+	}
+	return APR_SUCCESS;
+}
+
+static apr_status_t psync_queue_stage(struct async_queue *queue, struct async_queue_entry *ioop)
+{
+	struct psync_platform_queue *q = (struct psync_platform_queue*) queue->platform_queue;
+
+	APR_RING_INSERT_TAIL(&q->staged, ioop, async_queue_entry, link);
+	return APR_SUCCESS;
+}
+
+/* Hand the staged batch to the pool under one lock */
+static apr_status_t psync_queue_submit(struct async_queue *queue)
+{
+	struct psync_platform_queue *q = (struct psync_platform_queue*) queue->platform_queue;
+
+	if(APR_RING_EMPTY(&q->staged, async_queue_entry, link))
+		return APR_SUCCESS;
+
+	apr_thread_mutex_lock(q->mutex);
+	APR_RING_CONCAT(&q->submitted, &q->staged, async_queue_entry, link);
+	apr_thread_cond_broadcast(q->submitted_cond);
+	apr_thread_mutex_unlock(q->mutex);
+
+	return APR_SUCCESS;
+}
+
+static apr_status_t psync_queue_wait(struct async_queue *queue, int min_events)
+{
+	struct psync_platform_queue *q = (struct psync_platform_queue*) queue->platform_queue;
+	struct async_ioop_ring reaped;
+	struct async_queue_entry *ioop;
+	int error;
+
+	APR_RING_INIT(&reaped, async_queue_entry, link);
+
+	apr_thread_mutex_lock(q->mutex);
+	while(q->completed_count < (uint32_t) min_events) {
+		apr_thread_cond_wait(q->completed_cond, q->mutex);
+	}
+	APR_RING_CONCAT(&reaped, &q->completed, async_queue_entry, link);
+	q->completed_count = 0;
+	error = q->error;
+	apr_thread_mutex_unlock(q->mutex);
+
+	while(!APR_RING_EMPTY(&reaped, async_queue_entry, link)) {
+		ioop = APR_RING_FIRST(&reaped);
+		APR_RING_REMOVE(ioop, link);
+
+		/* notify */
+		generic_queue_notify(queue, ioop);
+	}
+	return error ? APR_EGENERAL : APR_SUCCESS;
+}
+
+struct platform_ops linux_psync_platform_ops = {
+	&linux_create_io_buffer,
+	&linux_get_pagesize,
+	&linux_get_min_io_size,
+	&linux_get_io_counters,
+	&linux_get_cpu_time,
+	&linux_get_numa_nodes,
+	&linux_bind_thread,
+	&linux_bind_io_buffer,
+	&linux_file_open,
+	&linux_file_truncate,
+	&linux_file_close,
+	&linux_file_flush,
+	&linux_file_datasync,
+	&linux_file_evict,
+	&linux_file_discard,
+	&linux_file_numa_node,
+	&psync_queue_create,
+	&psync_queue_destroy,
+	&psync_queue_stage,
+	&psync_queue_stage,
+	&psync_queue_wait,
+	&psync_queue_submit,
+	"psync"
+};
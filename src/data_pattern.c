@@ -0,0 +1,697 @@
+/*
+  * data_pattern.c
+  *
+  * Part of diskBench - IO bandwidth measurement
+  *
+  * Copyright (C) 2010-2011  Amund Elstad <amund.elstad@gmail.com>
+  *
+  *  This program is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *   the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  This program is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *   GNU General Public License for more details.
+  *
+  *   You should have received a copy of the GNU General Public License
+  *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+#include "diskBench.h"
+
+/*
+ * Data written by diskBench. Every 512 byte sector holds
+ *
+ *   word 0       the file offset of the sector
+ *   word 1       a seed s                    (random data)
+ *   word 2..63   x(s), x(x(s)), ...          x is random_uint64_t()
+ *
+ * or NONRANDOM_CONSTANT in word 1..63. Each sector can be verified on its
+ * own. The xorshift chain within a sector is serial, so the vector kernels
+ * run one sector per lane and transpose the lanes into consecutive words
+ * before storing. Sector seeds are a mixed xorshift stream, so they do not
+ * depend on the previous sector's chain.
+ */
+
+#define SECTOR_WORDS (DATA_PATTERN_SECTOR/sizeof(uint64_t))
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DATA_PATTERN_X86
+#include <immintrin.h>
+#endif
+
+typedef void (*fill_kernel)(uint64_t *buf, uint64_t sectors, uint64_t offset, uint64_t *seed);
+/* Return 1 if all sectors hold the pattern */
+typedef int (*verify_kernel)(const uint64_t *buf, uint64_t sectors, uint64_t offset);
+
+static uint64_t sector_seed(uint64_t *seed)
+{
+    uint64_t x = random_uint64_t(seed);
+
+    x ^= x >> 30;
+    x *= UINT64_C(0xbf58476d1ce4e5b9);
+    x ^= x >> 27;
+    x *= UINT64_C(0x94d049bb133111eb);
+    x ^= x >> 31;
+    /* xorshift never leaves 0 */
+    return x != 0 ? x : 1;
+}
+
+static void fill_random_scalar(uint64_t *buf, uint64_t sectors, uint64_t offset, uint64_t *seed)
+{
+    uint64_t i, w, s;
+
+    for(i=0; i < sectors; ++i) {
+        s = sector_seed(seed);
+        buf[0] = offset + i*DATA_PATTERN_SECTOR;
+        buf[1] = s;
+        for(w=2; w < SECTOR_WORDS; ++w) {
+            buf[w] = random_uint64_t(&s);
+        }
+        buf += SECTOR_WORDS;
+    }
+}
+
+/* Differences are or'ed together, a request either verifies or fails as a whole */
+static int verify_random_scalar(const uint64_t *buf, uint64_t sectors, uint64_t offset)
+{
+    uint64_t i, w, s;
+    uint64_t diff = 0;
+
+    for(i=0; i < sectors; ++i) {
+        diff |= buf[0] ^ (offset + i*DATA_PATTERN_SECTOR);
+        s = buf[1];
+        for(w=2; w < SECTOR_WORDS; ++w) {
+            diff |= buf[w] ^ random_uint64_t(&s);
+        }
+        buf += SECTOR_WORDS;
+    }
+    return diff == 0;
+}
+
+static int verify_constant_scalar(const uint64_t *buf, uint64_t sectors, uint64_t offset)
+{
+    uint64_t i, w;
+    uint64_t diff = 0;
+
+    for(i=0; i < sectors; ++i) {
+        diff |= buf[0] ^ (offset + i*DATA_PATTERN_SECTOR);
+        for(w=1; w < SECTOR_WORDS; ++w) {
+            diff |= buf[w] ^ NONRANDOM_CONSTANT;
+        }
+        buf += SECTOR_WORDS;
+    }
+    return diff == 0;
+}
+
+#ifdef DATA_PATTERN_X86
+
+/* Two sectors per 128 bit register */
+__attribute__((target("sse2")))
+static void fill_random_sse2(uint64_t *buf, uint64_t sectors, uint64_t offset, uint64_t *seed)
+{
+    __m128i v, x0, x1;
+    uint64_t *s0, *s1;
+    uint64_t i, w;
+
+    for(i=0; i + 2 <= sectors; i += 2) {
+        s0 = buf + i*SECTOR_WORDS;
+        s1 = s0 + SECTOR_WORDS;
+        s0[0] = offset + i*DATA_PATTERN_SECTOR;
+        s1[0] = s0[0] + DATA_PATTERN_SECTOR;
+        s0[1] = sector_seed(seed);
+        s1[1] = sector_seed(seed);
+        v = _mm_set_epi64x((long long) s1[1], (long long) s0[1]);
+        for(w=2; w < SECTOR_WORDS; w += 2) {
+            v = _mm_xor_si128(v, _mm_slli_epi64(v, 13));
+            v = _mm_xor_si128(v, _mm_srli_epi64(v, 7));
+            x0 = v = _mm_xor_si128(v, _mm_slli_epi64(v, 17));
+            v = _mm_xor_si128(v, _mm_slli_epi64(v, 13));
+            v = _mm_xor_si128(v, _mm_srli_epi64(v, 7));
+            x1 = v = _mm_xor_si128(v, _mm_slli_epi64(v, 17));
+            _mm_storeu_si128((__m128i*) (s0 + w), _mm_unpacklo_epi64(x0, x1));
+            _mm_storeu_si128((__m128i*) (s1 + w), _mm_unpackhi_epi64(x0, x1));
+        }
+    }
+    fill_random_scalar(buf + i*SECTOR_WORDS, sectors - i, offset + i*DATA_PATTERN_SECTOR, seed);
+}
+
+__attribute__((target("sse2")))
+static int verify_random_sse2(const uint64_t *buf, uint64_t sectors, uint64_t offset)
+{
+    __m128i v, x0, x1;
+    __m128i acc = _mm_setzero_si128();
+    const uint64_t *s0, *s1;
+    uint64_t i, w;
+    uint64_t diff = 0;
+
+    for(i=0; i + 2 <= sectors; i += 2) {
+        s0 = buf + i*SECTOR_WORDS;
+        s1 = s0 + SECTOR_WORDS;
+        diff |= s0[0] ^ (offset + i*DATA_PATTERN_SECTOR);
+        diff |= s1[0] ^ (offset + (i+1)*DATA_PATTERN_SECTOR);
+        v = _mm_set_epi64x((long long) s1[1], (long long) s0[1]);
+        for(w=2; w < SECTOR_WORDS; w += 2) {
+            v = _mm_xor_si128(v, _mm_slli_epi64(v, 13));
+            v = _mm_xor_si128(v, _mm_srli_epi64(v, 7));
+            x0 = v = _mm_xor_si128(v, _mm_slli_epi64(v, 17));
+            v = _mm_xor_si128(v, _mm_slli_epi64(v, 13));
+            v = _mm_xor_si128(v, _mm_srli_epi64(v, 7));
+            x1 = v = _mm_xor_si128(v, _mm_slli_epi64(v, 17));
+            acc = _mm_or_si128(acc, _mm_xor_si128(_mm_loadu_si128((const __m128i*) (s0 + w)), _mm_unpacklo_epi64(x0, x1)));
+            acc = _mm_or_si128(acc, _mm_xor_si128(_mm_loadu_si128((const __m128i*) (s1 + w)), _mm_unpackhi_epi64(x0, x1)));
+        }
+    }
+    return diff == 0 && _mm_movemask_epi8(_mm_cmpeq_epi32(acc, _mm_setzero_si128())) == 0xFFFF &&
+        verify_random_scalar(buf + i*SECTOR_WORDS, sectors - i, offset + i*DATA_PATTERN_SECTOR);
+}
+
+__attribute__((target("sse2")))
+static int verify_constant_sse2(const uint64_t *buf, uint64_t sectors, uint64_t offset)
+{
+    const __m128i pattern = _mm_set1_epi64x((long long) NONRANDOM_CONSTANT);
+    __m128i acc = _mm_setzero_si128();
+    const uint64_t *s0;
+    uint64_t i, w;
+
+    for(i=0; i < sectors; ++i) {
+        s0 = buf + i*SECTOR_WORDS;
+        acc = _mm_or_si128(acc, _mm_xor_si128(_mm_loadu_si128((const __m128i*) s0),
+                                              _mm_set_epi64x((long long) NONRANDOM_CONSTANT, (long long) (offset + i*DATA_PATTERN_SECTOR))));
+        for(w=2; w < SECTOR_WORDS; w += 2) {
+            acc = _mm_or_si128(acc, _mm_xor_si128(_mm_loadu_si128((const __m128i*) (s0 + w)), pattern));
+        }
+    }
+    return _mm_movemask_epi8(_mm_cmpeq_epi32(acc, _mm_setzero_si128())) == 0xFFFF;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i xorshift_avx2(__m256i v)
+{
+    v = _mm256_xor_si256(v, _mm256_slli_epi64(v, 13));
+    v = _mm256_xor_si256(v, _mm256_srli_epi64(v, 7));
+    return _mm256_xor_si256(v, _mm256_slli_epi64(v, 17));
+}
+
+/* Store 4 consecutive words of 4 sectors, x<n> holds word w+n of every sector */
+__attribute__((target("avx2")))
+static inline void store_transposed_avx2(uint64_t *s0, uint64_t w, __m256i x0, __m256i x1, __m256i x2, __m256i x3)
+{
+    __m256i t0 = _mm256_unpacklo_epi64(x0, x1);
+    __m256i t1 = _mm256_unpackhi_epi64(x0, x1);
+    __m256i t2 = _mm256_unpacklo_epi64(x2, x3);
+    __m256i t3 = _mm256_unpackhi_epi64(x2, x3);
+
+    _mm256_storeu_si256((__m256i*) (s0 + w), _mm256_permute2x128_si256(t0, t2, 0x20));
+    _mm256_storeu_si256((__m256i*) (s0 + SECTOR_WORDS + w), _mm256_permute2x128_si256(t1, t3, 0x20));
+    _mm256_storeu_si256((__m256i*) (s0 + 2*SECTOR_WORDS + w), _mm256_permute2x128_si256(t0, t2, 0x31));
+    _mm256_storeu_si256((__m256i*) (s0 + 3*SECTOR_WORDS + w), _mm256_permute2x128_si256(t1, t3, 0x31));
+}
+
+/* Store 2 consecutive words of 4 sectors */
+__attribute__((target("avx2")))
+static inline void store_transposed2_avx2(uint64_t *s0, uint64_t w, __m256i x0, __m256i x1)
+{
+    __m256i t0 = _mm256_unpacklo_epi64(x0, x1);
+    __m256i t1 = _mm256_unpackhi_epi64(x0, x1);
+
+    _mm_storeu_si128((__m128i*) (s0 + w), _mm256_castsi256_si128(t0));
+    _mm_storeu_si128((__m128i*) (s0 + SECTOR_WORDS + w), _mm256_castsi256_si128(t1));
+    _mm_storeu_si128((__m128i*) (s0 + 2*SECTOR_WORDS + w), _mm256_extracti128_si256(t0, 1));
+    _mm_storeu_si128((__m128i*) (s0 + 3*SECTOR_WORDS + w), _mm256_extracti128_si256(t1, 1));
+}
+
+/* Compare 4 consecutive words of 4 sectors, or differences into acc */
+__attribute__((target("avx2")))
+static inline __m256i verify_transposed_avx2(__m256i acc, const uint64_t *s0, uint64_t w, __m256i x0, __m256i x1, __m256i x2, __m256i x3)
+{
+    __m256i t0 = _mm256_unpacklo_epi64(x0, x1);
+    __m256i t1 = _mm256_unpackhi_epi64(x0, x1);
+    __m256i t2 = _mm256_unpacklo_epi64(x2, x3);
+    __m256i t3 = _mm256_unpackhi_epi64(x2, x3);
+
+    acc = _mm256_or_si256(acc, _mm256_xor_si256(_mm256_loadu_si256((const __m256i*) (s0 + w)), _mm256_permute2x128_si256(t0, t2, 0x20)));
+    acc = _mm256_or_si256(acc, _mm256_xor_si256(_mm256_loadu_si256((const __m256i*) (s0 + SECTOR_WORDS + w)), _mm256_permute2x128_si256(t1, t3, 0x20)));
+    acc = _mm256_or_si256(acc, _mm256_xor_si256(_mm256_loadu_si256((const __m256i*) (s0 + 2*SECTOR_WORDS + w)), _mm256_permute2x128_si256(t0, t2, 0x31)));
+    return _mm256_or_si256(acc, _mm256_xor_si256(_mm256_loadu_si256((const __m256i*) (s0 + 3*SECTOR_WORDS + w)), _mm256_permute2x128_si256(t1, t3, 0x31)));
+}
+
+/* Compare 2 consecutive words of 4 sectors */
+__attribute__((target("avx2")))
+static inline __m256i verify_transposed2_avx2(__m256i acc, const uint64_t *s0, uint64_t w, __m256i x0, __m256i x1)
+{
+    __m256i t0 = _mm256_unpacklo_epi64(x0, x1);
+    __m256i t1 = _mm256_unpackhi_epi64(x0, x1);
+    /* t0 holds sector 0 and 2, t1 sector 1 and 3 */
+    __m256i r0 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*) (s0 + w))),
+                                         _mm_loadu_si128((const __m128i*) (s0 + 2*SECTOR_WORDS + w)), 1);
+    __m256i r1 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*) (s0 + SECTOR_WORDS + w))),
+                                         _mm_loadu_si128((const __m128i*) (s0 + 3*SECTOR_WORDS + w)), 1);
+
+    acc = _mm256_or_si256(acc, _mm256_xor_si256(r0, t0));
+    return _mm256_or_si256(acc, _mm256_xor_si256(r1, t1));
+}
+
+/* Four sectors per 256 bit register */
+__attribute__((target("avx2")))
+static void fill_random_avx2(uint64_t *buf, uint64_t sectors, uint64_t offset, uint64_t *seed)
+{
+    __m256i v, x0, x1, x2, x3;
+    uint64_t *s0;
+    uint64_t i, j, w;
+
+    for(i=0; i + 4 <= sectors; i += 4) {
+        s0 = buf + i*SECTOR_WORDS;
+        for(j=0; j < 4; ++j) {
+            s0[j*SECTOR_WORDS] = offset + (i+j)*DATA_PATTERN_SECTOR;
+            s0[j*SECTOR_WORDS + 1] = sector_seed(seed);
+        }
+        v = _mm256_set_epi64x((long long) s0[3*SECTOR_WORDS + 1], (long long) s0[2*SECTOR_WORDS + 1],
+                              (long long) s0[SECTOR_WORDS + 1], (long long) s0[1]);
+        /* 62 words: 15 groups of 4 and one of 2 */
+        for(w=2; w + 4 <= SECTOR_WORDS; w += 4) {
+            x0 = v = xorshift_avx2(v);
+            x1 = v = xorshift_avx2(v);
+            x2 = v = xorshift_avx2(v);
+            x3 = v = xorshift_avx2(v);
+            store_transposed_avx2(s0, w, x0, x1, x2, x3);
+        }
+        x0 = v = xorshift_avx2(v);
+        x1 = v = xorshift_avx2(v);
+        store_transposed2_avx2(s0, w, x0, x1);
+    }
+    fill_random_scalar(buf + i*SECTOR_WORDS, sectors - i, offset + i*DATA_PATTERN_SECTOR, seed);
+}
+
+__attribute__((target("avx2")))
+static int verify_random_avx2(const uint64_t *buf, uint64_t sectors, uint64_t offset)
+{
+    __m256i v, x0, x1, x2, x3;
+    __m256i acc = _mm256_setzero_si256();
+    const uint64_t *s0;
+    uint64_t i, j, w;
+    uint64_t diff = 0;
+
+    for(i=0; i + 4 <= sectors; i += 4) {
+        s0 = buf + i*SECTOR_WORDS;
+        for(j=0; j < 4; ++j) {
+            diff |= s0[j*SECTOR_WORDS] ^ (offset + (i+j)*DATA_PATTERN_SECTOR);
+        }
+        v = _mm256_set_epi64x((long long) s0[3*SECTOR_WORDS + 1], (long long) s0[2*SECTOR_WORDS + 1],
+                              (long long) s0[SECTOR_WORDS + 1], (long long) s0[1]);
+        for(w=2; w + 4 <= SECTOR_WORDS; w += 4) {
+            x0 = v = xorshift_avx2(v);
+            x1 = v = xorshift_avx2(v);
+            x2 = v = xorshift_avx2(v);
+            x3 = v = xorshift_avx2(v);
+            acc = verify_transposed_avx2(acc, s0, w, x0, x1, x2, x3);
+        }
+        x0 = v = xorshift_avx2(v);
+        x1 = v = xorshift_avx2(v);
+        acc = verify_transposed2_avx2(acc, s0, w, x0, x1);
+    }
+    return diff == 0 && _mm256_testz_si256(acc, acc) &&
+        verify_random_scalar(buf + i*SECTOR_WORDS, sectors - i, offset + i*DATA_PATTERN_SECTOR);
+}
+
+__attribute__((target("avx2")))
+static int verify_constant_avx2(const uint64_t *buf, uint64_t sectors, uint64_t offset)
+{
+    const __m256i pattern = _mm256_set1_epi64x((long long) NONRANDOM_CONSTANT);
+    __m256i acc = _mm256_setzero_si256();
+    const uint64_t *s0;
+    uint64_t i, w;
+
+    for(i=0; i < sectors; ++i) {
+        s0 = buf + i*SECTOR_WORDS;
+        acc = _mm256_or_si256(acc, _mm256_xor_si256(_mm256_loadu_si256((const __m256i*) s0),
+                                                    _mm256_set_epi64x((long long) NONRANDOM_CONSTANT, (long long) NONRANDOM_CONSTANT,
+                                                                      (long long) NONRANDOM_CONSTANT, (long long) (offset + i*DATA_PATTERN_SECTOR))));
+        for(w=4; w < SECTOR_WORDS; w += 4) {
+            acc = _mm256_or_si256(acc, _mm256_xor_si256(_mm256_loadu_si256((const __m256i*) (s0 + w)), pattern));
+        }
+    }
+    return _mm256_testz_si256(acc, acc);
+}
+
+__attribute__((target("avx512f")))
+static inline __m512i xorshift_avx512(__m512i v)
+{
+    v = _mm512_xor_si512(v, _mm512_slli_epi64(v, 13));
+    v = _mm512_xor_si512(v, _mm512_srli_epi64(v, 7));
+    return _mm512_xor_si512(v, _mm512_slli_epi64(v, 17));
+}
+
+/* Eight sectors per 512 bit register, stored as two groups of four */
+__attribute__((target("avx512f")))
+static void fill_random_avx512(uint64_t *buf, uint64_t sectors, uint64_t offset, uint64_t *seed)
+{
+    __m512i v, x0, x1, x2, x3;
+    uint64_t *s0;
+    uint64_t i, j, w;
+
+    for(i=0; i + 8 <= sectors; i += 8) {
+        s0 = buf + i*SECTOR_WORDS;
+        for(j=0; j < 8; ++j) {
+            s0[j*SECTOR_WORDS] = offset + (i+j)*DATA_PATTERN_SECTOR;
+            s0[j*SECTOR_WORDS + 1] = sector_seed(seed);
+        }
+        v = _mm512_set_epi64((long long) s0[7*SECTOR_WORDS + 1], (long long) s0[6*SECTOR_WORDS + 1],
+                             (long long) s0[5*SECTOR_WORDS + 1], (long long) s0[4*SECTOR_WORDS + 1],
+                             (long long) s0[3*SECTOR_WORDS + 1], (long long) s0[2*SECTOR_WORDS + 1],
+                             (long long) s0[SECTOR_WORDS + 1], (long long) s0[1]);
+        for(w=2; w + 4 <= SECTOR_WORDS; w += 4) {
+            x0 = v = xorshift_avx512(v);
+            x1 = v = xorshift_avx512(v);
+            x2 = v = xorshift_avx512(v);
+            x3 = v = xorshift_avx512(v);
+            store_transposed_avx2(s0, w, _mm512_castsi512_si256(x0), _mm512_castsi512_si256(x1),
+                                  _mm512_castsi512_si256(x2), _mm512_castsi512_si256(x3));
+            store_transposed_avx2(s0 + 4*SECTOR_WORDS, w, _mm512_extracti64x4_epi64(x0, 1), _mm512_extracti64x4_epi64(x1, 1),
+                                  _mm512_extracti64x4_epi64(x2, 1), _mm512_extracti64x4_epi64(x3, 1));
+        }
+        x0 = v = xorshift_avx512(v);
+        x1 = v = xorshift_avx512(v);
+        store_transposed2_avx2(s0, w, _mm512_castsi512_si256(x0), _mm512_castsi512_si256(x1));
+        store_transposed2_avx2(s0 + 4*SECTOR_WORDS, w, _mm512_extracti64x4_epi64(x0, 1), _mm512_extracti64x4_epi64(x1, 1));
+    }
+    fill_random_scalar(buf + i*SECTOR_WORDS, sectors - i, offset + i*DATA_PATTERN_SECTOR, seed);
+}
+
+__attribute__((target("avx512f")))
+static int verify_random_avx512(const uint64_t *buf, uint64_t sectors, uint64_t offset)
+{
+    __m512i v, x0, x1, x2, x3;
+    __m256i acc = _mm256_setzero_si256();
+    const uint64_t *s0;
+    uint64_t i, j, w;
+    uint64_t diff = 0;
+
+    for(i=0; i + 8 <= sectors; i += 8) {
+        s0 = buf + i*SECTOR_WORDS;
+        for(j=0; j < 8; ++j) {
+            diff |= s0[j*SECTOR_WORDS] ^ (offset + (i+j)*DATA_PATTERN_SECTOR);
+        }
+        v = _mm512_set_epi64((long long) s0[7*SECTOR_WORDS + 1], (long long) s0[6*SECTOR_WORDS + 1],
+                             (long long) s0[5*SECTOR_WORDS + 1], (long long) s0[4*SECTOR_WORDS + 1],
+                             (long long) s0[3*SECTOR_WORDS + 1], (long long) s0[2*SECTOR_WORDS + 1],
+                             (long long) s0[SECTOR_WORDS + 1], (long long) s0[1]);
+        for(w=2; w + 4 <= SECTOR_WORDS; w += 4) {
+            x0 = v = xorshift_avx512(v);
+            x1 = v = xorshift_avx512(v);
+            x2 = v = xorshift_avx512(v);
+            x3 = v = xorshift_avx512(v);
+            acc = verify_transposed_avx2(acc, s0, w, _mm512_castsi512_si256(x0), _mm512_castsi512_si256(x1),
+                                         _mm512_castsi512_si256(x2), _mm512_castsi512_si256(x3));
+            acc = verify_transposed_avx2(acc, s0 + 4*SECTOR_WORDS, w, _mm512_extracti64x4_epi64(x0, 1), _mm512_extracti64x4_epi64(x1, 1),
+                                         _mm512_extracti64x4_epi64(x2, 1), _mm512_extracti64x4_epi64(x3, 1));
+        }
+        x0 = v = xorshift_avx512(v);
+        x1 = v = xorshift_avx512(v);
+        acc = verify_transposed2_avx2(acc, s0, w, _mm512_castsi512_si256(x0), _mm512_castsi512_si256(x1));
+        acc = verify_transposed2_avx2(acc, s0 + 4*SECTOR_WORDS, w, _mm512_extracti64x4_epi64(x0, 1), _mm512_extracti64x4_epi64(x1, 1));
+    }
+    return diff == 0 && _mm256_testz_si256(acc, acc) &&
+        verify_random_scalar(buf + i*SECTOR_WORDS, sectors - i, offset + i*DATA_PATTERN_SECTOR);
+}
+
+__attribute__((target("avx512f")))
+static int verify_constant_avx512(const uint64_t *buf, uint64_t sectors, uint64_t offset)
+{
+    const __m512i pattern = _mm512_set1_epi64((long long) NONRANDOM_CONSTANT);
+    __m512i acc = _mm512_setzero_si512();
+    const uint64_t *s0;
+    uint64_t i, w;
+
+    for(i=0; i < sectors; ++i) {
+        s0 = buf + i*SECTOR_WORDS;
+        /* word 0 is the offset */
+        acc = _mm512_or_si512(acc, _mm512_xor_si512(_mm512_loadu_si512(s0),
+                                                    _mm512_mask_set1_epi64(pattern, 1, (long long) (offset + i*DATA_PATTERN_SECTOR))));
+        for(w=8; w < SECTOR_WORDS; w += 8) {
+            acc = _mm512_or_si512(acc, _mm512_xor_si512(_mm512_loadu_si512(s0 + w), pattern));
+        }
+    }
+    return _mm512_test_epi64_mask(acc, acc) == 0;
+}
+
+#endif
+
+struct data_pattern_kernel {
+    const char *name;
+    fill_kernel fill_random;
+    verify_kernel verify_random;
+    verify_kernel verify_constant;
+};
+
+/* Fastest first */
+static const struct data_pattern_kernel kernels[] = {
+#ifdef DATA_PATTERN_X86
+    { "avx512", &fill_random_avx512, &verify_random_avx512, &verify_constant_avx512 },
+    { "avx2", &fill_random_avx2, &verify_random_avx2, &verify_constant_avx2 },
+    { "sse2", &fill_random_sse2, &verify_random_sse2, &verify_constant_sse2 },
+#endif
+    { "scalar", &fill_random_scalar, &verify_random_scalar, &verify_constant_scalar },
+    { NULL, NULL, NULL, NULL }
+};
+
+static const struct data_pattern_kernel *scalar = &kernels[sizeof(kernels)/sizeof(kernels[0]) - 2];
+static const struct data_pattern_kernel *selected = &kernels[sizeof(kernels)/sizeof(kernels[0]) - 2];
+
+static int kernel_supported(const struct data_pattern_kernel *kernel)
+{
+#ifdef DATA_PATTERN_X86
+    __builtin_cpu_init();
+    if(strcmp(kernel->name, "avx512") == 0)
+        return __builtin_cpu_supports("avx512f");
+    if(strcmp(kernel->name, "avx2") == 0)
+        return __builtin_cpu_supports("avx2");
+    if(strcmp(kernel->name, "sse2") == 0)
+        return __builtin_cpu_supports("sse2");
+#endif
+    return 1;
+}
+
+int data_pattern_select(const char *name)
+{
+    const struct data_pattern_kernel *kernel;
+
+    for(kernel = kernels; kernel->name != NULL; ++kernel) {
+        if((strcmp(name, "auto") == 0 || strcmp(name, kernel->name) == 0) && kernel_supported(kernel)) {
+            selected = kernel;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+const char *data_pattern_kernel()
+{
+    return selected->name;
+}
+
+void data_pattern_fill(void *buf, uint64_t size, uint64_t offset, int random, uint64_t *seed)
+{
+    uint64_t *words = (uint64_t *) buf;
+    uint64_t sectors = size / DATA_PATTERN_SECTOR;
+    uint64_t i, w;
+
+    if(random) {
+        selected->fill_random(words, sectors, offset, seed);
+    } else {
+        for(i=0; i < sectors; ++i) {
+            words[i*SECTOR_WORDS] = offset + i*DATA_PATTERN_SECTOR;
+            for(w=1; w < SECTOR_WORDS; ++w) {
+                words[i*SECTOR_WORDS + w] = NONRANDOM_CONSTANT;
+            }
+        }
+    }
+
+    /* partial last sector */
+    words += sectors*SECTOR_WORDS;
+    offset += sectors*DATA_PATTERN_SECTOR;
+    size -= sectors*DATA_PATTERN_SECTOR;
+    if(size >= sizeof(uint64_t)) {
+        uint64_t tail[SECTOR_WORDS];
+        if(random) {
+            fill_random_scalar(tail, 1, offset, seed);
+        } else {
+            tail[0] = offset;
+            for(w=1; w < SECTOR_WORDS; ++w) {
+                tail[w] = NONRANDOM_CONSTANT;
+            }
+        }
+        memcpy(words, tail, size - size % sizeof(uint64_t));
+    }
+}
+
+int data_pattern_verify(const void *buf, uint64_t size, uint64_t offset, int random)
+{
+    const uint64_t *words = (const uint64_t *) buf;
+    uint64_t sectors = size / DATA_PATTERN_SECTOR;
+    uint64_t n, w, s;
+
+    if(!(random ? selected->verify_random : selected->verify_constant)(words, sectors, offset))
+        return 0;
+
+    /* partial last sector */
+    words += sectors*SECTOR_WORDS;
+    n = (size - sectors*DATA_PATTERN_SECTOR) / sizeof(uint64_t);
+    if(n > 0 && words[0] != offset + sectors*DATA_PATTERN_SECTOR)
+        return 0;
+    s = n > 1 ? words[1] : 0;
+    for(w = random ? 2 : 1; w < n; ++w) {
+        if(words[w] != (random ? random_uint64_t(&s) : NONRANDOM_CONSTANT))
+            return 0;
+    }
+    return 1;
+}
+
+/*
+ * Pattern pool: random sectors generated once. A write copies a run of
+ * them, starting at a random sector of the pool, and stamps the offset of
+ * each sector. Pool sectors keep their seed and chain, so the result reads
+ * back like freshly generated data and needs no special verification.
+ */
+uint64_t *data_pattern_pool_create(uint64_t size, uint64_t *seed)
+{
+    uint64_t *pool = malloc(size);
+
+    if(pool != NULL)
+        data_pattern_fill(pool, size, 0, 1, seed);
+    return pool;
+}
+
+void data_pattern_fill_pool(void *buf, uint64_t size, uint64_t offset, const uint64_t *pool, uint64_t pool_sectors, uint64_t *seed)
+{
+    uint64_t *words = (uint64_t *) buf;
+    uint64_t sectors = size / DATA_PATTERN_SECTOR;
+    uint64_t index = random_uint64_t(seed) % pool_sectors;
+    uint64_t i, run;
+
+    for(i=0; i < sectors; i += run) {
+        run = sectors - i;
+        if(run > pool_sectors - index)
+            run = pool_sectors - index;
+        memcpy(words + i*SECTOR_WORDS, pool + index*SECTOR_WORDS, run*DATA_PATTERN_SECTOR);
+        index = (index + run) % pool_sectors;
+    }
+    for(i=0; i < sectors; ++i) {
+        words[i*SECTOR_WORDS] = offset + i*DATA_PATTERN_SECTOR;
+    }
+
+    /* partial last sector */
+    size -= sectors*DATA_PATTERN_SECTOR;
+    if(size >= sizeof(uint64_t)) {
+        memcpy(words + sectors*SECTOR_WORDS, pool + index*SECTOR_WORDS, size - size % sizeof(uint64_t));
+        words[sectors*SECTOR_WORDS] = offset + sectors*DATA_PATTERN_SECTOR;
+    }
+}
+
+#define BENCHMARK_SIZE (8*1024*1024)
+#define BENCHMARK_ROUNDS 32
+#define BENCHMARK_POOL_SIZE (256*1024)
+/* odd number of sectors, so every kernel also runs its scalar tail */
+#define BENCHMARK_CHECK_SIZE (1021*DATA_PATTERN_SECTOR)
+
+/*
+ * Check kernel against the scalar path: both fill the same bytes from the
+ * same seed, and each verifies what the other wrote.
+ */
+static int kernel_agrees(const struct data_pattern_kernel *kernel, uint64_t *buf, uint64_t *reference, uint64_t *seed)
+{
+    uint64_t sectors = BENCHMARK_CHECK_SIZE / DATA_PATTERN_SECTOR;
+    /* last sector of the last full group of 8, in the vector loop of every kernel */
+    uint64_t flipped = (sectors / 8) * 8 - 1;
+    uint64_t kernel_seed = *seed;
+    int ok;
+
+    kernel->fill_random(buf, sectors, BENCHMARK_CHECK_SIZE, &kernel_seed);
+    scalar->fill_random(reference, sectors, BENCHMARK_CHECK_SIZE, seed);
+    ok = kernel_seed == *seed
+        && memcmp(buf, reference, BENCHMARK_CHECK_SIZE) == 0
+        && scalar->verify_random(buf, sectors, BENCHMARK_CHECK_SIZE)
+        && kernel->verify_random(reference, sectors, BENCHMARK_CHECK_SIZE);
+
+    /* a flipped bit in the last vector group must be caught */
+    reference[flipped*SECTOR_WORDS + 37] ^= 1;
+    ok = ok && !kernel->verify_random(reference, sectors, BENCHMARK_CHECK_SIZE);
+
+    data_pattern_fill(reference, BENCHMARK_CHECK_SIZE, BENCHMARK_CHECK_SIZE, 0, seed);
+    ok = ok && kernel->verify_constant(reference, sectors, BENCHMARK_CHECK_SIZE);
+    reference[flipped*SECTOR_WORDS + 37] ^= 1;
+    return ok && !kernel->verify_constant(reference, sectors, BENCHMARK_CHECK_SIZE);
+}
+
+/* Fill and verify throughput of every supported kernel, in GB/s */
+void data_pattern_benchmark()
+{
+    const struct data_pattern_kernel *kernel, *previous = selected;
+    uint64_t *buf = malloc(BENCHMARK_SIZE);
+    uint64_t *reference = malloc(BENCHMARK_CHECK_SIZE);
+    uint64_t *pool;
+    uint64_t seed = UINT64_C(88172645463325252);
+    apr_time_t start, fill, verify;
+    int i, random, ok = 1;
+
+    if(buf == NULL || reference == NULL) {
+        printf("Could not allocate benchmark buffers\n");
+        free(buf);
+        free(reference);
+        return;
+    }
+
+    printf("%-10s %-10s %12s %12s\n", "Kernel", "Data", "Fill GB/s", "Verify GB/s");
+    for(kernel = kernels; kernel->name != NULL; ++kernel) {
+        if(!kernel_supported(kernel))
+            continue;
+        if(!kernel_agrees(kernel, buf, reference, &seed)) {
+            printf("ERROR: %s kernel disagrees with the scalar kernel\n", kernel->name);
+            ok = 0;
+        }
+        selected = kernel;
+        for(random=1; random >= 0; --random) {
+            start = apr_time_now();
+            for(i=0; i < BENCHMARK_ROUNDS; ++i) {
+                data_pattern_fill(buf, BENCHMARK_SIZE, (uint64_t) i*BENCHMARK_SIZE, random, &seed);
+            }
+            fill = apr_time_now() - start;
+            start = apr_time_now();
+            for(i=0; i < BENCHMARK_ROUNDS; ++i) {
+                ok &= data_pattern_verify(buf, BENCHMARK_SIZE, (uint64_t) (BENCHMARK_ROUNDS - 1)*BENCHMARK_SIZE, random);
+            }
+            verify = apr_time_now() - start;
+            printf("%-10s %-10s %12.2f %12.2f\n", kernel->name, random ? "random" : "constant",
+                   (double) BENCHMARK_ROUNDS*BENCHMARK_SIZE/(fill > 0 ? fill : 1)/1000.0,
+                   (double) BENCHMARK_ROUNDS*BENCHMARK_SIZE/(verify > 0 ? verify : 1)/1000.0);
+        }
+    }
+    selected = previous;
+
+    /* 4K writes from a cache sized pool, verified by the selected kernel */
+    pool = data_pattern_pool_create(BENCHMARK_POOL_SIZE, &seed);
+    if(pool == NULL) {
+        printf("Could not allocate benchmark pool\n");
+        free(reference);
+        free(buf);
+        return;
+    }
+    start = apr_time_now();
+    for(i=0; i < BENCHMARK_ROUNDS; ++i) {
+        uint64_t off;
+        for(off=0; off < BENCHMARK_SIZE; off += 4096) {
+            data_pattern_fill_pool((char *) buf + off, 4096, (uint64_t) i*BENCHMARK_SIZE + off, pool, BENCHMARK_POOL_SIZE/DATA_PATTERN_SECTOR, &seed);
+        }
+    }
+    fill = apr_time_now() - start;
+    ok &= data_pattern_verify(buf, BENCHMARK_SIZE, (uint64_t) (BENCHMARK_ROUNDS - 1)*BENCHMARK_SIZE, 1);
+    printf("%-10s %-10s %12.2f %12s\n", "pool", "random",
+           (double) BENCHMARK_ROUNDS*BENCHMARK_SIZE/(fill > 0 ? fill : 1)/1000.0, "-");
+    free(pool);
+
+    if(!ok)
+        printf("ERROR: pattern kernels disagree\n");
+    free(reference);
+    free(buf);
+}
@@ -0,0 +1,137 @@
+/*
+  * discard_workload.c
+  *
+  * Part of diskBench - IO bandwidth measurement
+  *
+  * Copyright (C) 2010-2011  Amund Elstad <amund.elstad@gmail.com>
+  *
+  *  This program is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *   the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  This program is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *   GNU General Public License for more details.
+  *
+  *   You should have received a copy of the GNU General Public License
+  *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+#include "diskBench.h"
+
+/*
+ * Writes interleaved with discards. The file is rewritten in regions of
+ * granularity bytes picked at random. The given fraction of the regions is
+ * discarded before it is rewritten, like free space reused by a file system
+ * or log-structured store with online discard. Discard requests are flagged
+ * and issued by ioworker.
+ */
+
+ struct discard_request_generator_data {
+    double fraction;
+    uint64_t granularity;
+    uint64_t req_size;
+
+    uint64_t regions;
+    uint64_t pos;
+    uint64_t region_end;
+};
+
+static apr_status_t discard_request_generator_fill_request(
+    struct io_workload_generator *workload_generator,
+    struct io_request *request
+)
+{
+    struct discard_request_generator_data *data = (struct discard_request_generator_data*) workload_generator->generator_data;
+    uint64_t *random_seed = &workload_generator->workload->worker->random_seed;
+
+    if(data->pos >= data->region_end) {
+        data->pos = (random_uint64_t(random_seed) % data->regions) * data->granularity;
+        data->region_end = data->pos + data->granularity;
+        if((random_uint64_t(random_seed) >> 11) * (1.0/9007199254740992.0) < data->fraction) {
+            request->offset = data->pos;
+            request->size = data->granularity;
+            request->write = 0;
+            request->discard = 1;
+            return APR_SUCCESS;
+        }
+    }
+
+    request->offset = data->pos;
+    request->size = data->req_size;
+    request->write = 1;
+    data->pos += data->req_size;
+
+    return APR_SUCCESS;
+}
+
+static uint64_t discard_request_generator_max_iosize(struct io_workload_generator *workload_generator)
+{
+    struct discard_request_generator_data *data = (struct discard_request_generator_data*) workload_generator->generator_data;
+
+    return data->req_size;
+}
+
+static uint64_t discard_request_generator_weighted_iosize(struct io_workload_generator *workload_generator)
+{
+    return UINT64_C(4*1024);
+}
+
+
+static apr_status_t discard_request_generator_reset(struct io_workload_generator *template_generator, struct io_workload *workload, uint64_t reqsize)
+{
+    struct discard_request_generator_data *data;
+
+    if(workload->request_generator != NULL) {
+        if(workload->request_generator->generator_data != NULL) {
+            free(workload->request_generator->generator_data);
+        }
+        free(workload->request_generator);
+        workload->request_generator = NULL;
+    }
+    ((struct discard_request_generator_data*) template_generator->generator_data)->req_size = reqsize;
+
+    workload->request_generator = malloc(sizeof(struct io_workload_generator));
+    memcpy(workload->request_generator, template_generator, sizeof(struct io_workload_generator));
+    data = malloc(sizeof(struct discard_request_generator_data));
+    memcpy(data, template_generator->generator_data, sizeof(struct discard_request_generator_data));
+
+    /* whole requests per region */
+    data->granularity = data->granularity - data->granularity % reqsize;
+    if(data->granularity < reqsize)
+        data->granularity = reqsize;
+    data->regions = workload->worker->filesize / data->granularity;
+    if(data->regions == 0)
+        data->regions = 1;
+    data->pos = 0;
+    data->region_end = 0;
+    workload->request_generator->generator_data = data;
+    workload->request_generator->workload = workload;
+
+    return APR_SUCCESS;
+}
+
+apr_status_t discard_request_generator_factory(
+    struct io_workload_generator **request_generator,
+    double fraction,
+    uint64_t granularity
+)
+{
+    struct discard_request_generator_data *data;
+
+    if(fraction < 0.0 || fraction > 1.0 || granularity == 0)
+        return APR_EINVAL;
+
+    data = calloc(1, sizeof(struct discard_request_generator_data));
+    *request_generator = malloc(sizeof(struct io_workload_generator));
+    data->fraction = fraction;
+    data->granularity = granularity;
+    (*request_generator)->generator_data = data;
+    (*request_generator)->fill_request = &discard_request_generator_fill_request;
+    (*request_generator)->max_io_size = &discard_request_generator_max_iosize;
+    (*request_generator)->weighted_io_size = &discard_request_generator_weighted_iosize;
+    (*request_generator)->reset = &discard_request_generator_reset;
+
+    return APR_SUCCESS;
+}
@@ -23,6 +23,49 @@
 
 #define MAX_QUEUE_SIZE (4096)
 
+/* Options without a short option */
+#define OPT_SQPOLL 256
+#define OPT_REAP_BATCH 257
+#define OPT_BUFFERED 258
+#define OPT_CACHE_STATE 259
+#define OPT_MADVISE 260
+#define OPT_POLLED 261
+#define OPT_THREADS_PER_FILE 262
+#define OPT_THREAD_RANGE 263
+#define OPT_NUMA 264
+#define OPT_CPUS 265
+#define OPT_BUFFER_MODE 266
+#define OPT_SEGMENTS 267
+#define OPT_SKEW 268
+#define OPT_TRACE 269
+#define OPT_TRACE_PACING 270
+#define OPT_MIX 271
+#define OPT_MIX_PROFILE 272
+#define OPT_RATE 273
+#define OPT_ARRIVAL 274
+#define OPT_STREAMS 275
+#define OPT_STREAM_LAYOUT 276
+#define OPT_STREAM_ORDER 277
+#define OPT_PATTERNS 278
+#define OPT_ALIGNMENT 279
+#define OPT_WORKING_SET 280
+#define OPT_RW_SWEEP 281
+#define OPT_RW_SWEEP_IO 282
+#define OPT_WAL 283
+#define OPT_WAL_COMMIT 284
+#define OPT_WAL_SIZE 285
+#define OPT_DISCARD 286
+#define OPT_DISCARD_SIZE 287
+#define OPT_SIMD 288
+#define OPT_VERIFY_THREADS 289
+#define OPT_PATTERN_POOL 290
+
+/* indexed by NUMA_* */
+static const char *numa_modes[] = { "off", "local", "remote", "compare" };
+
+/* Max sleep while waiting for a scheduled request with IO in flight */
+#define SCHEDULE_POLL_INTERVAL 50
+
 #define REQUEST_FMT ("%3.1f %c")
 #define THROUGHPUT_FMT ("%3.1f %cB/s")
 #define BYTES_FMT ("%3.1f %cB")
@@ -36,14 +79,41 @@ static void *APR_THREAD_FUNC ioworker(apr_thread_t *thd, void *data)
 	struct io_request *req;
 	struct async_queue *queue;
 	struct async_queue_entry *ioop;
+	struct async_queue_entry **batch;
+	/* filled request waiting for its scheduled time */
+	struct async_queue_entry *held = NULL;
 
 	int events;
+	int batched;
+	int i;
+	int iolimit_reached = 0;
 	apr_status_t rv;
 	apr_time_t terminate_at;
+	apr_time_t now;
+	apr_time_t delay;
+	/* open-loop: intended issue time of the next request, relative to start */
+	double next_arrival = 0.0;
+	double u;
+	/* WAL: writes since the last commit and when the first was submitted */
+	int commit_writes = worker->options->commit_writes;
+	apr_time_t commit_interval = worker->options->commit_interval;
+	int group_writes = 0;
+	apr_time_t group_start = 0;
+	apr_time_t last_commit;
+	apr_time_t sync_start;
+
+    /* Pin before the queue is created so engine threads inherit the placement */
+    if(worker->options->platform_ops->bind_thread != NULL && (worker->cpu >= 0 || worker->numa_node >= 0)) {
+        rv = worker->options->platform_ops->bind_thread(worker->cpu, worker->numa_node);
+        if(rv != APR_SUCCESS) {
+            printf("Could not bind thread of %s to cpu %d/node %d\n", worker->filename, worker->cpu, worker->numa_node);
+        }
+    }
 
     /* Generate IO-queue */
 	rv = generic_queue_create(workload, workload->queue_depth, &queue);
 	assert(rv == APR_SUCCESS);
+	batch = malloc(sizeof(struct async_queue_entry*)*workload->queue_depth);
 
     /* initalize to zero */
     workload->submitted_bytes = 0;
@@ -60,47 +130,158 @@ static void *APR_THREAD_FUNC ioworker(apr_thread_t *thd, void *data)
     workload->write_elapsed = 0;
     workload->write_max_latency = 0;
     workload->write_min_latency = 0;
+    memset(workload->latency_histogram, 0, sizeof(workload->latency_histogram));
+    workload->commits = 0;
+    workload->sync_elapsed = 0;
+    workload->commit_max_latency = 0;
+    memset(workload->commit_histogram, 0, sizeof(workload->commit_histogram));
+    workload->discards = 0;
+    workload->discard_bytes = 0;
+    workload->discard_failures = 0;
+    workload->discard_elapsed = 0;
+    workload->verify_requests = 0;
+    workload->verify_bytes = 0;
+    workload->verify_elapsed = 0;
+    workload->verify_delay = 0;
 
     workload->start_time = apr_time_now();
     terminate_at = workload->start_time + worker->options->max_execution_time;
+    last_commit = workload->start_time;
+
+	while(!iolimit_reached && apr_time_now() <= terminate_at) {
+        /* Refill all free queue-entries and submit them as one batch */
+        batched = 0;
+        while(queue->free > 0) {
+            /* group is complete, wait for the commit */
+            if(commit_writes > 0 && group_writes >= commit_writes)
+                break;
+            if(held != NULL) {
+                ioop = held;
+                held = NULL;
+                req = &ioop->request;
+            } else {
+                /* Fetch queue-entry */
+                ioop = APR_RING_FIRST(queue->ready);
+                APR_RING_REMOVE(ioop, link);
+
+                req = &ioop->request;
+                /* check if request will override IO-limit */
+                if(workload->submitted_bytes + req->size > worker->iolimit) {
+                    APR_RING_INSERT_TAIL(queue->ready, ioop, async_queue_entry, link);
+                    iolimit_reached = 1;
+                    break;
+                }
 
-	while(apr_time_now() <= terminate_at) {
-        /* Fetch queue-entry */
-        ioop = APR_RING_FIRST(queue->ready);
-        APR_RING_REMOVE(ioop, link);
+                /* Call request-generator */
+                req->scheduled = 0;
+                req->discard = 0;
+                rv = workload->request_generator->fill_request(workload->request_generator, req);
+                assert(rv == APR_SUCCESS);
+                req->offset += worker->offset_base;
+
+                /* discards are synchronous and do not use the queue-entry */
+                if(req->discard) {
+                    APR_RING_INSERT_HEAD(queue->ready, ioop, async_queue_entry, link);
+                    now = apr_time_now();
+                    rv = APR_ENOTIMPL;
+                    if(worker->options->platform_ops->file_discard != NULL)
+                        rv = worker->options->platform_ops->file_discard(worker->file, req->offset, req->size);
+                    if(rv == APR_SUCCESS) {
+                        workload->discards += 1;
+                        workload->discard_bytes += req->size;
+                        workload->discard_elapsed += apr_time_now() - now;
+                    } else {
+                        workload->discard_failures += 1;
+                    }
+                    /* discarded data no longer matches the pattern */
+                    if(req->offset < worker->last_integrity_written_offset)
+                        worker->last_integrity_written_offset = req->offset;
+                    continue;
+                }
 
-        req = &ioop->request;
-        /* check if request will override IO-limit */
-        if(workload->submitted_bytes + req->size > worker->iolimit) {
-            APR_RING_INSERT_TAIL(queue->ready, ioop, async_queue_entry, link);
-            break;
-        }
+                /* open-loop: issue on the arrival schedule, independent of completions */
+                if(workload->arrival_rate > 0 && req->scheduled == 0) {
+                    req->scheduled = next_arrival >= 1.0 ? (apr_time_t) next_arrival : 1;
+                    if(worker->options->arrival == ARRIVAL_POISSON) {
+                        u = (random_uint64_t(&worker->random_seed) >> 11) * (1.0/9007199254740992.0);
+                        next_arrival += -log(1.0 - u) * APR_USEC_PER_SEC / workload->arrival_rate;
+                    } else {
+                        next_arrival += APR_USEC_PER_SEC / workload->arrival_rate;
+                    }
+                }
+            }
 
-        queue->free = queue->free - 1;
-        queue->active = queue->active + 1;
+            /* hold requests scheduled in the future */
+            if(req->scheduled > 0 && workload->start_time + req->scheduled > apr_time_now()) {
+                held = ioop;
+                break;
+            }
 
-        /* Call request-generator */
-        rv = workload->request_generator->fill_request(workload->request_generator, req);
-        assert(rv == APR_SUCCESS);
+            queue->free = queue->free - 1;
+            queue->active = queue->active + 1;
+
+            /* queue io */
+            req->pre_submission = apr_time_now();
+            if(req->write) {
+                rv = generic_queue_write(queue, ioop);
+                assert(rv == APR_SUCCESS);
+            } else {
+                rv = generic_queue_read(queue, ioop);
+                assert(rv == APR_SUCCESS);
+            }
+            workload->submitted_bytes += req->size;
+            batch[batched++] = ioop;
+            /* WAL: a commit group is commit_writes writes */
+            if((commit_writes > 0 || commit_interval > 0) && req->write) {
+                if(group_writes++ == 0)
+                    group_start = req->pre_submission;
+            }
+        }
 
         /* submit io */
-		req->pre_submission = apr_time_now();
-		if(req->write) {
-			rv = generic_queue_write(queue, ioop);
-			assert(rv == APR_SUCCESS);
-		} else {
-			rv = generic_queue_read(queue, ioop);
-			assert(rv == APR_SUCCESS);
-		}
-        workload->submitted_bytes += req->size;
+        rv = generic_queue_submit(queue);
+        assert(rv == APR_SUCCESS);
 
-		req->post_submission = apr_time_now();
+        now = apr_time_now();
+        for(i=0; i < batched; ++i) {
+            batch[i]->request.post_submission = now;
+        }
 		if(queue->active > workload->max_active) {
 			workload->max_active = queue->active;
 		}
 		events = 0;
 		rv = generic_queue_wait(queue, &events);
 		assert(rv==APR_SUCCESS);
+
+		/* WAL commit: wait for the group and make it durable */
+		if((commit_writes > 0 || commit_interval > 0) && group_writes > 0
+		   && ((commit_writes > 0 && group_writes >= commit_writes)
+		       || (commit_interval > 0 && apr_time_now() >= last_commit + commit_interval))) {
+		    rv = generic_queue_barrier(queue);
+		    assert(rv==APR_SUCCESS);
+		    sync_start = apr_time_now();
+		    rv = worker->options->platform_ops->file_datasync(worker->file);
+		    assert(rv==APR_SUCCESS);
+		    now = apr_time_now();
+		    workload->commits += 1;
+		    workload->sync_elapsed += now - sync_start;
+		    workload->commit_max_latency = max_time(workload->commit_max_latency, now - group_start);
+		    workload->commit_histogram[latency_bucket(now - group_start)] += 1;
+		    group_writes = 0;
+		    last_commit = now;
+		}
+
+		if(held != NULL) {
+		    /* sleep until the held request is due, keep reaping completions meanwhile */
+		    now = apr_time_now();
+		    delay = workload->start_time + held->request.scheduled - now;
+		    if(now + delay > terminate_at)
+		        delay = terminate_at - now;
+		    if(queue->active > 0 && delay > SCHEDULE_POLL_INTERVAL)
+		        delay = SCHEDULE_POLL_INTERVAL;
+		    if(delay > 0)
+		        apr_sleep(delay);
+		}
 	}
 	rv = generic_queue_barrier(queue);
 	assert(rv==APR_SUCCESS);
@@ -109,6 +290,7 @@ static void *APR_THREAD_FUNC ioworker(apr_thread_t *thd, void *data)
 
 	rv = generic_queue_destroy(queue);
     assert(rv==APR_SUCCESS);
+    free(batch);
 
 	apr_thread_exit(thd, APR_SUCCESS);
 	return NULL;
@@ -133,6 +315,78 @@ static uint64_t parse_size(const char *value)
     return rv;
 }
 
+/* Parse a size distribution like 4K:60,8K:30,12K:10. Weights default to 1 */
+static int parse_size_distribution(apr_pool_t *pool, const char *value, struct mixed_size_distribution *distribution)
+{
+    char *token, *last, *weight;
+
+    distribution->count = 0;
+    token = apr_strtok(apr_pstrdup(pool, value), ",", &last);
+    while(token != NULL) {
+        if(distribution->count == MIXED_MAX_SIZES)
+            return 0;
+        weight = strchr(token, ':');
+        if(weight != NULL) {
+            *weight = '\0';
+            ++weight;
+        }
+        distribution->sizes[distribution->count] = parse_size(token);
+        distribution->weights[distribution->count] = weight != NULL ? atof(weight) : 1.0;
+        if(distribution->sizes[distribution->count] == 0 || distribution->weights[distribution->count] <= 0.0)
+            return 0;
+        distribution->count = distribution->count + 1;
+        token = apr_strtok(NULL, ",", &last);
+    }
+    return distribution->count > 0;
+}
+
+/* Direct IO needs whole sectors. Checked once the sector size is known */
+static int size_distribution_aligned(const struct mixed_size_distribution *distribution, uint32_t sector_size)
+{
+    int i;
+
+    for(i=0; i < distribution->count; ++i) {
+        if(distribution->sizes[i] % sector_size != 0)
+            return 0;
+    }
+    return 1;
+}
+
+/*
+ * Apply one key=value setting of a mixed profile. Percentages of sequential
+ * IO are relative to reads/writes. Returns 0 on error.
+ */
+static int parse_mixed_profile_setting(apr_pool_t *pool, char *setting, struct mixed_profile *profile)
+{
+    char *value = strchr(setting, '=');
+    double percent;
+
+    if(value == NULL)
+        return 0;
+    *value = '\0';
+    ++value;
+    percent = atof(value);
+
+    if(strcmp(setting, "name") == 0) {
+        profile->name = apr_pstrdup(pool, value);
+    } else if(strcmp(setting, "random") == 0) {
+        return parse_size_distribution(pool, value, &profile->random_sizes);
+    } else if(strcmp(setting, "sequential") == 0) {
+        return parse_size_distribution(pool, value, &profile->sequential_sizes);
+    } else if(percent < 0.0 || percent > 100.0) {
+        return 0;
+    } else if(strcmp(setting, "read") == 0) {
+        profile->read_fraction = percent/100.0;
+    } else if(strcmp(setting, "seqread") == 0) {
+        profile->sequential_read_fraction = percent/100.0;
+    } else if(strcmp(setting, "seqwrite") == 0) {
+        profile->sequential_write_fraction = percent/100.0;
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
 static char* print_size(apr_pool_t *pool, char *fmt, double value, int kvalue)
 {
     const char ordbig[] = " KMGT";
@@ -262,8 +516,11 @@ static apr_status_t create_worker(char *filename,
     (*worker)->configured_iolimit = iolimit;
     (*worker)->random_seed = UINT64_C(88172645463325252);
     (*worker)->last_integrity_written_offset = 0;
+    (*worker)->device_node = -1;
+    (*worker)->numa_node = -1;
+    (*worker)->cpu = -1;
 
-    rv = platform_ops->create_io_buffer(&((*worker)->buf), bufsize);
+    rv = platform_ops->create_io_buffer(&((*worker)->buf), bufsize, options->buffer_flags, &((*worker)->buffer_flags));
     assert(rv == APR_SUCCESS);
 
     (*worker)->bufsize = bufsize;
@@ -271,11 +528,68 @@ static apr_status_t create_worker(char *filename,
     return rv;
 }
 
+/*
+ * Create threads_per_file workers sharing the file of worker. Each gets its own
+ * slice of the IO buffer and either a disjoint part of the file or all of it.
+ */
+static apr_status_t create_worker_threads(struct io_worker *worker, int threads_per_file,
+    int shared_range, struct io_worker **threads)
+{
+    struct io_worker *thread;
+    uint64_t bufsize;
+    uint64_t range;
+    uint64_t range_end;
+    int i;
+
+    bufsize = worker->bufsize / threads_per_file;
+    bufsize = bufsize - bufsize % worker->options->platform_ops->get_page_size();
+    if(bufsize == 0)
+        return APR_EINVAL;
+
+    range = shared_range ? worker->filesize : worker->filesize / threads_per_file;
+    if(range > 1024*1024) {
+        /* keep parts aligned for direct IO */
+        range = range - range % (1024*1024);
+    }
+
+    for(i=0; i < threads_per_file; ++i) {
+        thread = calloc(1, sizeof(struct io_worker));
+        memcpy(thread, worker, sizeof(struct io_worker));
+        thread->parent = worker;
+        thread->workload = NULL;
+        thread->buf = worker->buf + i*bufsize;
+        thread->bufsize = bufsize;
+        thread->filesize = range;
+        thread->offset_base = shared_range ? 0 : i*range;
+        if(worker->configured_iolimit != UINT64_MAX) {
+            thread->configured_iolimit = worker->configured_iolimit / threads_per_file;
+        }
+        thread->iolimit = thread->configured_iolimit;
+
+        /* independent random streams */
+        thread->random_seed = worker->random_seed ^ (UINT64_C(0x9E3779B97F4A7C15)*(i+1));
+        random_uint64_t(&thread->random_seed);
+
+        /* only data written by the preparation can be validated */
+        range_end = thread->offset_base + range;
+        if(shared_range || worker->last_integrity_written_offset < range_end) {
+            thread->last_integrity_written_offset = worker->last_integrity_written_offset;
+        } else {
+            thread->last_integrity_written_offset = range_end;
+        }
+        if(thread->last_integrity_written_offset < thread->offset_base) {
+            thread->last_integrity_written_offset = thread->offset_base;
+        }
+        threads[i] = thread;
+    }
+    return APR_SUCCESS;
+}
+
 static apr_status_t open_worker(struct io_worker *worker, double freespace_utilization)
 {
     apr_status_t rv;
 
-    rv = worker->options->platform_ops->file_open(worker->filename, &(worker->filesize),
+    rv = worker->options->platform_ops->file_open(worker->filename, worker->options->buffered, &(worker->filesize),
                                                   freespace_utilization,
                                                   &(worker->truncate_file),
                                                   &(worker->file));
@@ -285,6 +599,42 @@ static apr_status_t open_worker(struct io_worker *worker, double freespace_utili
 
 }
 
+/*
+ * Bind threads and IO buffers of workers to the node of their device (local)
+ * or another node (remote). Workers on devices without a known node are left alone.
+ */
+static apr_status_t place_workers(struct io_worker **workers, int count, int numa_mode)
+{
+    struct platform_ops *ops;
+    struct io_worker *worker;
+    int nodes;
+    int i;
+    apr_status_t rv;
+
+    for(i=0; i < count; ++i) {
+        worker = workers[i];
+        ops = worker->options->platform_ops;
+        worker->numa_node = -1;
+        if(numa_mode == NUMA_OFF || worker->device_node < 0 || ops->bind_io_buffer == NULL)
+            continue;
+
+        nodes = ops->get_numa_nodes();
+        if(numa_mode == NUMA_REMOTE) {
+            if(nodes < 2)
+                continue;
+            worker->numa_node = (worker->device_node + 1) % nodes;
+        } else {
+            worker->numa_node = worker->device_node;
+        }
+
+        rv = ops->bind_io_buffer(worker->buf, worker->bufsize, worker->numa_node);
+        if(rv != APR_SUCCESS) {
+            printf("Could not bind IO buffer of %s to node %d\n", worker->filename, worker->numa_node);
+        }
+    }
+    return APR_SUCCESS;
+}
+
 static apr_status_t destroy_workers(struct io_worker **workers, int count, apr_pool_t *pool)
 {
 	struct io_worker *worker;
@@ -292,9 +642,16 @@ static apr_status_t destroy_workers(struct io_worker **workers, int count, apr_p
 	apr_status_t rv;
 	for(i=0; i < count; ++i) {
 		worker = workers[i];
+		if(worker->parent != NULL) {
+		    /* file is owned by parent */
+		    free(worker);
+		    continue;
+		}
 
 		rv = platform_ops->file_close(worker->file);
 		assert(rv == APR_SUCCESS);
+		if(worker->pattern_pool != NULL)
+		    free(worker->pattern_pool);
 		if(worker->truncate_file && !worker->options->keep_files) {
             apr_file_remove(worker->filename, pool);
 		}
@@ -306,21 +663,52 @@ static apr_status_t destroy_workers(struct io_worker **workers, int count, apr_p
 
 static apr_status_t print_statistics_seperator(apr_pool_t *pool)
 {
-    printf("-------------------------------------------------------------------------------------------------------------------------------------------------------\n");
+    printf("---------------------------------------------------------------------------------------------------------------------------------------------------------------\n");
 }
 
 static apr_status_t print_statistics_header(apr_pool_t *pool)
 {
-    printf("%-25s  %9s  %8s  %12s  %13s  %10s  %10s  %11s  %11s  %11s  %11s\n",
-           "","Parallel","Avg IO","","","Bytes","Bytes","Time","Min","Avg","Max");
-    printf("%-25s  %9s  %8s  %12s  %13s  %10s  %10s  %11s  %11s  %11s  %11s\n",
-           "Workload","IOs","Size","Throughput","IOPS", "Written","Read","Elapsed","Latency","Latency","Latency");
+    printf("%-25s  %9s  %8s  %12s  %13s  %10s  %10s  %11s  %11s  %11s  %11s  %6s\n",
+           "","Parallel","Avg IO","","","Bytes","Bytes","Time","Min","Avg","Max","");
+    printf("%-25s  %9s  %8s  %12s  %13s  %10s  %10s  %11s  %11s  %11s  %11s  %6s\n",
+           "Workload","IOs","Size","Throughput","IOPS", "Written","Read","Elapsed","Latency","Latency","Latency","CPU");
     print_statistics_seperator(pool);
 }
 
+/* Process wide counters sampled around each test */
+struct process_counters {
+    uint64_t device_bytes_read;
+    uint64_t device_bytes_written;
+    apr_time_t cpu_time;
+};
+
+static void sample_process_counters(struct io_worker_options *options, struct process_counters *counters)
+{
+    memset(counters, 0, sizeof(struct process_counters));
+    if(options->platform_ops->get_io_counters != NULL) {
+        options->platform_ops->get_io_counters(&counters->device_bytes_read, &counters->device_bytes_written);
+    }
+    options->platform_ops->get_cpu_time(&counters->cpu_time);
+}
+
+/* Latency below which fraction of the requests completed */
+static apr_time_t latency_percentile(uint64_t *histogram, uint64_t total, double fraction)
+{
+    uint64_t rank = (uint64_t) ceil(fraction * total);
+    uint64_t seen = 0;
+    int i;
+
+    for(i=0; i < LATENCY_BUCKETS; ++i) {
+        seen += histogram[i];
+        if(seen >= rank && seen > 0)
+            return latency_bucket_value(i);
+    }
+    return latency_bucket_value(LATENCY_BUCKETS-1);
+}
+
 static apr_status_t dump_statistics(apr_pool_t *pool, struct io_worker_options *options,
     struct io_statistics *statistics, struct io_worker **workers,
-    int count)
+    int count, struct process_counters *start, struct process_counters *end)
 {
 	struct io_workload *workload;
 	struct io_statistics_line line;
@@ -329,7 +717,22 @@ static apr_status_t dump_statistics(apr_pool_t *pool, struct io_worker_options *
 	apr_time_t max;
 
 	int i;
+	int j;
 	int max_active=0;
+	uint64_t histogram[LATENCY_BUCKETS];
+	uint64_t commit_histogram[LATENCY_BUCKETS];
+	uint64_t commits = 0;
+	apr_time_t sync_elapsed = 0;
+	apr_time_t commit_max_latency = 0;
+	uint64_t discards = 0;
+	uint64_t discard_bytes = 0;
+	uint64_t discard_failures = 0;
+	apr_time_t discard_elapsed = 0;
+	uint64_t verify_requests = 0;
+	uint64_t verify_bytes = 0;
+	apr_time_t verify_elapsed = 0;
+	apr_time_t verify_delay = 0;
+	apr_time_t p50, p90, p99, p999;
 
 	uint64_t weighted_iosize;
 	uint64_t avg_iosize;
@@ -345,8 +748,12 @@ static apr_status_t dump_statistics(apr_pool_t *pool, struct io_worker_options *
     line.write_requests = 0;
     line.weight = 0.0;
     line.weighted_bytes_per_second = 0.0;
+    line.device_bytes_read = end->device_bytes_read - start->device_bytes_read;
+    line.device_bytes_written = end->device_bytes_written - start->device_bytes_written;
     char *xml_fragment="";
 
+    memset(histogram, 0, sizeof(histogram));
+    memset(commit_histogram, 0, sizeof(commit_histogram));
     xml_fragment = print_xml_tag_open(pool, xml_fragment, "test_run");
     xml_fragment = print_xml_tag_open(pool, xml_fragment, "workloads");
 	for(i=0; i < count; ++i) {
@@ -369,6 +776,21 @@ static apr_status_t dump_statistics(apr_pool_t *pool, struct io_worker_options *
 
 
         total_latency += (workload->read_elapsed + workload->write_elapsed);
+        for(j=0; j < LATENCY_BUCKETS; ++j) {
+            histogram[j] += workload->latency_histogram[j];
+            commit_histogram[j] += workload->commit_histogram[j];
+        }
+        commits += workload->commits;
+        sync_elapsed += workload->sync_elapsed;
+        commit_max_latency = max_time(commit_max_latency, workload->commit_max_latency);
+        discards += workload->discards;
+        discard_bytes += workload->discard_bytes;
+        discard_failures += workload->discard_failures;
+        discard_elapsed += workload->discard_elapsed;
+        verify_requests += workload->verify_requests;
+        verify_bytes += workload->verify_bytes;
+        verify_elapsed += workload->verify_elapsed;
+        verify_delay += workload->verify_delay;
 		weighted_iosize = workload->request_generator->weighted_io_size(workload->request_generator);
 		max_active += workload->max_active;
 		line.read_requests += workload->read_requests;
@@ -396,21 +818,24 @@ static apr_status_t dump_statistics(apr_pool_t *pool, struct io_worker_options *
 		    line.max_write_latency = max_time(line.max_write_latency, workload->write_max_latency);
 		}
 
-        avg_iosize = (workload->read_bytes + workload->write_bytes)/(workload->read_requests + workload->write_requests);
-        bytes_per_second =
-            (((double) workload->read_bytes + workload->write_bytes)/(double) (workload->end_time-workload->start_time))
-            *apr_time_from_sec(1);
+        /* a thread whose share of the IO limit is below one request completes none */
+        if(workload->read_requests + workload->write_requests > 0) {
+            avg_iosize = (workload->read_bytes + workload->write_bytes)/(workload->read_requests + workload->write_requests);
+            bytes_per_second =
+                (((double) workload->read_bytes + workload->write_bytes)/(double) (workload->end_time-workload->start_time))
+                *apr_time_from_sec(1);
 
 
-        if(avg_iosize < weighted_iosize)
-            weight = weighted_iosize/avg_iosize;
-        else
-            weight = avg_iosize/weighted_iosize;
+            if(avg_iosize < weighted_iosize)
+                weight = weighted_iosize/avg_iosize;
+            else
+                weight = avg_iosize/weighted_iosize;
 
-        weight = 10.0/(weight + workload->queue_depth);
+            weight = 10.0/(weight + workload->queue_depth);
 
-        line.weighted_bytes_per_second += weight *bytes_per_second;
-        line.weight += weight / count;
+            line.weighted_bytes_per_second += weight *bytes_per_second;
+            line.weight += weight / count;
+        }
 
         xml_fragment = print_xml_tag_close(pool, xml_fragment, "workload");
 	}
@@ -438,6 +863,7 @@ static apr_status_t dump_statistics(apr_pool_t *pool, struct io_worker_options *
 	line.avg_latency = ((double) total_latency) / ((double)line.total_requests);
 	line.bytes_per_second = ((double)line.total_bytes/(double)line.total_elapsed)*apr_time_from_sec(1);
 	line.bytes_per_io =(double)line.total_bytes/(double) line.total_requests;
+	line.cpu_utilization = (100.0*(end->cpu_time - start->cpu_time))/(double) line.total_elapsed;
 
     if(statistics->lines->nelts == 0) {
         statistics->bytes_read = line.bytes_read;
@@ -470,7 +896,7 @@ static apr_status_t dump_statistics(apr_pool_t *pool, struct io_worker_options *
 	xml_fragment = print_xml_tag_close(pool, xml_fragment, "workloads");
 
     double iops = (((double) line.total_requests)/(double) (line.total_elapsed))*apr_time_from_sec(1);
-	printf("%-25s  %9d  %8s  %12s  %13s  %10s  %10s  %11s  %11s  %11s  %11s\n",
+	printf("%-25s  %9d  %8s  %12s  %13s  %10s  %10s  %11s  %11s  %11s  %11s  %5.0f%%\n",
 	statistics->description,
 	max_active,
 	print_size(pool, BYTES_FMT, line.bytes_per_io, K),
@@ -481,7 +907,8 @@ static apr_status_t dump_statistics(apr_pool_t *pool, struct io_worker_options *
     print_time(pool, line.total_elapsed),
     print_time(pool, line.min_latency),
     print_time(pool, line.avg_latency),
-    print_time(pool, line.max_latency));
+    print_time(pool, line.max_latency),
+    line.cpu_utilization);
     xml_fragment = print_xml_tag_str(pool, xml_fragment, "description", statistics->description);
     xml_fragment = print_xml_tag_number(pool, xml_fragment, "concurrent_iops", max_active);
     xml_fragment = print_xml_tag_size(pool, xml_fragment, "bytes_per_io", BYTES_FMT, line.bytes_per_io);
@@ -495,6 +922,138 @@ static apr_status_t dump_statistics(apr_pool_t *pool, struct io_worker_options *
     xml_fragment = print_xml_tag_time(pool, xml_fragment, "min_latency", line.min_latency);
     xml_fragment = print_xml_tag_time(pool, xml_fragment, "avg_latency", line.avg_latency);
     xml_fragment = print_xml_tag_time(pool, xml_fragment, "max_latency", line.max_latency);
+    xml_fragment = print_xml_tag_number(pool, xml_fragment, "cpu_percent", (uint64_t) line.cpu_utilization);
+
+    p50 = latency_percentile(histogram, line.total_requests, 0.5);
+    p90 = latency_percentile(histogram, line.total_requests, 0.9);
+    p99 = latency_percentile(histogram, line.total_requests, 0.99);
+    p999 = latency_percentile(histogram, line.total_requests, 0.999);
+    if(options->target_iops > 0) {
+        /* latencies are measured from the intended issue time */
+        printf("%-25s  %9s  %8s  %12s  %13s  %10s  %10s  %11s  %11s  %11s  %11s\n",
+        "  offered, p50..p99.9",
+        "",
+        "",
+        "",
+        print_size(pool, IOPS_FMT, options->target_iops, K),
+        "",
+        "",
+        print_time(pool, p50),
+        print_time(pool, p90),
+        print_time(pool, p99),
+        print_time(pool, p999));
+        xml_fragment = print_xml_tag_size(pool, xml_fragment, "offered_iops", IOPS_FMT, options->target_iops);
+    }
+    xml_fragment = print_xml_tag_time(pool, xml_fragment, "p50_latency", p50);
+    xml_fragment = print_xml_tag_time(pool, xml_fragment, "p90_latency", p90);
+    xml_fragment = print_xml_tag_time(pool, xml_fragment, "p99_latency", p99);
+    xml_fragment = print_xml_tag_time(pool, xml_fragment, "p999_latency", p999);
+
+    if(commits > 0) {
+        /* WAL: latency from the first write of a group until fdatasync returned */
+        double commits_per_second = (((double) commits)/(double) line.total_elapsed)*apr_time_from_sec(1);
+        p50 = latency_percentile(commit_histogram, commits, 0.5);
+        p90 = latency_percentile(commit_histogram, commits, 0.9);
+        p99 = latency_percentile(commit_histogram, commits, 0.99);
+        p999 = latency_percentile(commit_histogram, commits, 0.999);
+        printf("%-25s  %9s  %8s  %12s  %13s  %10s  %10s  %11s  %11s  %11s  %11s\n",
+        "  commits, p50..p99.9",
+        "",
+        "",
+        "",
+        print_size(pool, "%3.1f %c/s", commits_per_second, K),
+        "",
+        "",
+        print_time(pool, p50),
+        print_time(pool, p90),
+        print_time(pool, p99),
+        print_time(pool, p999));
+        xml_fragment = print_xml_tag_size(pool, xml_fragment, "commits", REQUEST_FMT, commits);
+        xml_fragment = print_xml_tag_size(pool, xml_fragment, "commits_per_second", "%3.1f %c/s", commits_per_second);
+        xml_fragment = print_xml_tag_time(pool, xml_fragment, "avg_datasync_time", sync_elapsed / commits);
+        xml_fragment = print_xml_tag_time(pool, xml_fragment, "p50_commit_latency", p50);
+        xml_fragment = print_xml_tag_time(pool, xml_fragment, "p90_commit_latency", p90);
+        xml_fragment = print_xml_tag_time(pool, xml_fragment, "p99_commit_latency", p99);
+        xml_fragment = print_xml_tag_time(pool, xml_fragment, "p999_commit_latency", p999);
+        xml_fragment = print_xml_tag_time(pool, xml_fragment, "max_commit_latency", commit_max_latency);
+    }
+
+    if(discards > 0) {
+        /* discard time is spent in the submitting thread */
+        double discards_per_second = (((double) discards)/(double) line.total_elapsed)*apr_time_from_sec(1);
+        printf("%-25s  %9s  %8s  %12s  %13s  %10s  %10s  %11s  %11s  %11s\n",
+        "  discards",
+        "",
+        print_size(pool, BYTES_FMT, (double) discard_bytes / discards, K),
+        "",
+        print_size(pool, "%3.1f %c/s", discards_per_second, K),
+        print_size(pool, BYTES_FMT, (double) discard_bytes, K),
+        "",
+        "",
+        "",
+        print_time(pool, discard_elapsed / discards));
+        xml_fragment = print_xml_tag_size(pool, xml_fragment, "discards", REQUEST_FMT, discards);
+        xml_fragment = print_xml_tag_size(pool, xml_fragment, "bytes_discarded", BYTES_FMT, discard_bytes);
+        xml_fragment = print_xml_tag_time(pool, xml_fragment, "avg_discard_latency", discard_elapsed / discards);
+    }
+    if(discard_failures > 0) {
+        printf("%-25s\n", apr_psprintf(pool, "  %"APR_UINT64_T_FMT" discards failed or not supported", (apr_uint64_t) discard_failures));
+        xml_fragment = print_xml_tag_number(pool, xml_fragment, "discard_failures", discard_failures);
+    }
+
+    if(verify_requests > 0) {
+        /* verify pool: latencies above are device time, verification follows the completion */
+        double verify_bytes_per_second = ((double) verify_bytes/(double) (verify_elapsed > 0 ? verify_elapsed : 1))*apr_time_from_sec(1);
+        printf("%-25s  %9s  %8s  %12s  %13s  %10s  %10s  %11s  %11s  %11s  %11s\n",
+        "  verify, avg/delay",
+        "",
+        "",
+        print_size(pool, THROUGHPUT_FMT, verify_bytes_per_second, K),
+        "",
+        "",
+        print_size(pool, BYTES_FMT, (double) verify_bytes, K),
+        "",
+        "",
+        print_time(pool, verify_elapsed / verify_requests),
+        print_time(pool, verify_delay / verify_requests));
+        xml_fragment = print_xml_tag_size(pool, xml_fragment, "bytes_verified", BYTES_FMT, verify_bytes);
+        xml_fragment = print_xml_tag_size(pool, xml_fragment, "verify_bytes_per_second", THROUGHPUT_FMT, verify_bytes_per_second);
+        xml_fragment = print_xml_tag_time(pool, xml_fragment, "verify_time", verify_elapsed);
+        xml_fragment = print_xml_tag_time(pool, xml_fragment, "avg_verify_time", verify_elapsed / verify_requests);
+        xml_fragment = print_xml_tag_time(pool, xml_fragment, "avg_verify_delay", verify_delay / verify_requests);
+    }
+
+    if(options->buffered) {
+        /* Split throughput in what was served by the page cache and what reached the device */
+        uint64_t cache_bytes_read = line.bytes_read > line.device_bytes_read ? line.bytes_read - line.device_bytes_read : 0;
+        double device_bytes_per_second = (((double) line.device_bytes_read + line.device_bytes_written)/(double) line.total_elapsed)*apr_time_from_sec(1);
+        double cache_bytes_per_second = ((double) cache_bytes_read/(double) line.total_elapsed)*apr_time_from_sec(1);
+        double cache_hit_ratio = line.bytes_read > 0 ? (100.0*cache_bytes_read)/line.bytes_read : 0.0;
+
+        printf("%-25s  %9s  %8s  %12s  %13s  %10s  %10s\n",
+        apr_psprintf(pool, "  cache hit %5.1f%%", cache_hit_ratio),
+        "",
+        "",
+        print_size(pool, THROUGHPUT_FMT, cache_bytes_per_second, K),
+        "",
+        "",
+        print_size(pool, BYTES_FMT, (double) cache_bytes_read, K));
+        printf("%-25s  %9s  %8s  %12s  %13s  %10s  %10s\n",
+        "  device",
+        "",
+        "",
+        print_size(pool, THROUGHPUT_FMT, device_bytes_per_second, K),
+        "",
+        print_size(pool, BYTES_FMT, (double) line.device_bytes_written, K),
+        print_size(pool, BYTES_FMT, (double) line.device_bytes_read, K));
+
+        xml_fragment = print_xml_tag_size(pool, xml_fragment, "device_bytes_written", BYTES_FMT, line.device_bytes_written);
+        xml_fragment = print_xml_tag_size(pool, xml_fragment, "device_bytes_read", BYTES_FMT, line.device_bytes_read);
+        xml_fragment = print_xml_tag_size(pool, xml_fragment, "device_bytes_per_second", THROUGHPUT_FMT, device_bytes_per_second);
+        xml_fragment = print_xml_tag_size(pool, xml_fragment, "cache_bytes_read", BYTES_FMT, cache_bytes_read);
+        xml_fragment = print_xml_tag_size(pool, xml_fragment, "cache_bytes_per_second", THROUGHPUT_FMT, cache_bytes_per_second);
+        xml_fragment = print_xml_tag_number(pool, xml_fragment, "cache_hit_percent", (uint64_t) cache_hit_ratio);
+    }
     xml_fragment = print_xml_tag_close(pool, xml_fragment, "test_run");
     options->xml_output = apr_pstrcat(options->pool, options->xml_output, xml_fragment, NULL);
 
@@ -502,7 +1061,7 @@ static apr_status_t dump_statistics(apr_pool_t *pool, struct io_worker_options *
 }
 
 /* Run tests over a queue-depth test */
-static apr_status_t run_tests(
+static apr_status_t run_placed_tests(
     char *description,
     struct io_worker_options *options,
     struct io_worker **worker,
@@ -519,10 +1078,13 @@ static apr_status_t run_tests(
     struct io_statistics *statistics;
     struct io_statistics *separate_statistics;
     struct io_statistics *current_statistics;
+    struct process_counters start_counters;
+    struct process_counters end_counters;
  	apr_pool_t *pool;
  	apr_pool_t *local;
  	apr_status_t rv;
  	int i, depth, depthidx, reqsizeidx, gen_separate_statistics;
+ 	int active_workloads;
 
 
     statistics = NULL;
@@ -609,6 +1171,19 @@ static apr_status_t run_tests(
 
             current_statistics = gen_separate_statistics ? separate_statistics : statistics;
 
+            /* Spread the offered load evenly over the queues */
+            active_workloads = 0;
+            for(i=0; i< worker_count; ++i) {
+                if(worker[i]->workload != NULL)
+                    ++active_workloads;
+            }
+            for(i=0; i< worker_count; ++i) {
+                if(worker[i]->workload != NULL)
+                    worker[i]->workload->arrival_rate = options->target_iops / active_workloads;
+            }
+
+            sample_process_counters(options, &start_counters);
+
             /* Start threads */
             for(i=0; i< worker_count; ++i) {
                 if(worker[i]->workload == NULL)
@@ -629,9 +1204,20 @@ static apr_status_t run_tests(
                 assert(rv==APR_SUCCESS);
             }
 
+            sample_process_counters(options, &end_counters);
+
+            /* Start next test with a cold page cache */
+            if(options->buffered && options->cold_cache && options->platform_ops->file_evict != NULL) {
+                for(i=0; i<worker_count; ++i) {
+                    rv = worker[i]->options->platform_ops->file_evict(worker[i]->file);
+                    assert(rv==APR_SUCCESS);
+                }
+            }
+
             assert(rv == APR_SUCCESS);
             /* Dump statistics */
-            dump_statistics(local, options, current_statistics, worker, worker_count);
+            dump_statistics(local, options, current_statistics, worker, worker_count,
+                            &start_counters, &end_counters);
 
             double throughput = APR_ARRAY_IDX(current_statistics->lines,current_statistics->lines->nelts-1, struct io_statistics_line).bytes_per_second;
             depth_throughput[depthidx % MIN_TESTS] = throughput;
@@ -690,6 +1276,87 @@ static apr_status_t run_tests(
     apr_pool_destroy(local);
 
     free(threads);
+    return APR_SUCCESS;
+}
+
+/*
+ * Run tests once per tested segment count, offered load and working set, and
+ * twice with local and remote placement when comparing NUMA placement
+ */
+static apr_status_t run_tests(
+    char *description,
+    struct io_worker_options *options,
+    struct io_worker **worker,
+    int worker_count,
+    int auto_terminate_request,
+    int auto_terminate_depth,
+    uint64_t *max_reqsize,
+    uint64_t separate_statistics_reqsize,
+    char *separate_statistics_description)
+{
+    static const int placements[] = { NUMA_LOCAL, NUMA_REMOTE };
+    static char * const placement_suffixes[] = { " (local)", " (remote)" };
+    int placement_count = options->numa_mode == NUMA_COMPARE ? 2 : 1;
+    int segment_count = options->io_segments_array->nelts > 0 ? options->io_segments_array->nelts : 1;
+    int rate_count = options->rate_array->nelts > 0 ? options->rate_array->nelts : 1;
+    int working_set_count = options->working_set_array->nelts > 0 ? options->working_set_array->nelts : 1;
+    uint64_t max_filesize = 0;
+    char *suffix;
+    apr_status_t rv;
+    int i, j, k, l;
+
+    for(i=0; i < worker_count; ++i) {
+        if(worker[i]->filesize > max_filesize)
+            max_filesize = worker[i]->filesize;
+    }
+
+    for(j=0; j < segment_count; ++j) {
+        if(options->io_segments_array->nelts > 0) {
+            options->io_segments = APR_ARRAY_IDX(options->io_segments_array, j, int);
+        }
+        for(i=0; i < placement_count; ++i) {
+            if(options->numa_mode == NUMA_COMPARE) {
+                rv = place_workers(worker, worker_count, placements[i]);
+                assert(rv == APR_SUCCESS);
+            }
+            for(k=0; k < rate_count; ++k) {
+                for(l=0; l < working_set_count; ++l) {
+                    suffix = "";
+                    if(options->io_segments_array->nelts > 1) {
+                        suffix = apr_psprintf(options->pool, " %diov", options->io_segments);
+                    }
+                    if(options->numa_mode == NUMA_COMPARE) {
+                        suffix = apr_pstrcat(options->pool, suffix, placement_suffixes[i], NULL);
+                    }
+                    if(options->rate_array->nelts > 0) {
+                        options->target_iops = APR_ARRAY_IDX(options->rate_array, k, double);
+                        suffix = apr_psprintf(options->pool, "%s @%.0f IOPS", suffix, options->target_iops);
+                    }
+                    if(options->working_set_array->nelts > 0) {
+                        options->working_set = APR_ARRAY_IDX(options->working_set_array, l, uint64_t);
+                        /* once the files are covered larger working sets repeat the same result */
+                        if(l > 0 && options->working_set > max_filesize
+                           && APR_ARRAY_IDX(options->working_set_array, l-1, uint64_t) >= max_filesize)
+                            continue;
+                        suffix = apr_pstrcat(options->pool, suffix, " ws ",
+                            print_size(options->pool, "%.0f%cB",
+                                       options->working_set < max_filesize ? options->working_set : max_filesize, K), NULL);
+                    }
+                    rv = run_placed_tests(apr_pstrcat(options->pool, description, suffix, NULL),
+                        options, worker, worker_count,
+                        auto_terminate_request, auto_terminate_depth, max_reqsize,
+                        separate_statistics_reqsize,
+                        separate_statistics_description == NULL ? NULL :
+                            apr_pstrcat(options->pool, separate_statistics_description, suffix, NULL));
+                    assert(rv == APR_SUCCESS);
+                }
+            }
+        }
+    }
+    /* preparation and other direct runs are closed loop over the whole file */
+    options->target_iops = 0.0;
+    options->working_set = 0;
+    return APR_SUCCESS;
 }
 
 static void show_help(apr_getopt_option_t const *options)
@@ -723,6 +1390,25 @@ static void prepare_workload(struct io_worker *worker, struct io_workload_genera
     }
 }
 
+/*
+ * Largest request that fits in a queue entry of every worker at depth.
+ * run_tests stops at the first depth whose requests do not fit
+ */
+static uint64_t max_request_at_depth(struct io_worker **workers, int worker_count, uint32_t depth)
+{
+    uint64_t max_size = UINT64_MAX;
+    uint64_t bufsize;
+    int i;
+
+    for(i=0; i < worker_count; ++i) {
+        bufsize = workers[i]->bufsize / depth;
+        bufsize = bufsize - bufsize % workers[i]->options->platform_ops->get_page_size();
+        if(bufsize < max_size)
+            max_size = bufsize;
+    }
+    return max_size;
+}
+
 static char * print_array_size(apr_pool_t *pool, uint64_t max_size, apr_array_header_t *reqsizes)
 {
     int i=0;
@@ -757,17 +1443,91 @@ static char * print_array_depths(apr_pool_t *pool, uint32_t max_depth, apr_array
     return rv;
 }
 
+static char * print_buffer_flags(apr_pool_t *pool, int flags)
+{
+    static const char *names[] = { "hugetlb", "thp", "populate", "lock" };
+    char *rv = "";
+    int i;
+
+    for(i=0; i < 4; ++i) {
+        if(flags & (1 << i)) {
+            rv = apr_psprintf(pool, "%s%s%s", rv, *rv != '\0' ? "," : "", names[i]);
+        }
+    }
+    return *rv != '\0' ? rv : "default";
+}
+
+static char * print_array_ints(apr_pool_t *pool, apr_array_header_t *values, char *empty)
+{
+    char *rv = "";
+    int i;
+
+    if(values->nelts == 0)
+        return empty;
+
+    for(i=0; i < values->nelts; ++i) {
+        rv = apr_psprintf(pool, "%s%s%d", rv, i > 0 ? "," : "", APR_ARRAY_IDX(values, i, int));
+    }
+    return rv;
+}
+
 int main(int argc, const char * const * argv)
 {	
     struct io_worker_options options;
 	struct io_worker **workers;
+	struct io_worker **test_workers;
 	struct io_worker *worker;
+	int test_worker_count;
+	int threads_per_file = 1;
+	int shared_range = 0;
+	int verify_threads = 0;
+	apr_array_header_t *cpu_array;
+	int skew_distribution = 0;
+	double skew_param1 = 0.0;
+	double skew_param2 = 0.0;
+	char *skew_description = NULL;
+	const char *trace_filename = NULL;
+	int trace_timed = 0;
+	apr_array_header_t *stream_counts;
+	apr_array_header_t *requestsize_array_streams;
+	int stream_layout = STREAMS_REGION;
+	int stream_order = STREAMS_ROUND_ROBIN;
+	int write;
+	int first_statistics;
+	double stream_throughput;
+	double baseline_throughput;
+	apr_array_header_t *pattern_array;
+	uint64_t stride_gap = UINT64_C(64*1024);
+	char *pattern_description;
+	apr_array_header_t *alignment_array;
+	apr_array_header_t *requestsize_array_unaligned;
+	apr_array_header_t *working_sets;
+	apr_array_header_t *rw_sweep_reads;
+	apr_array_header_t *rw_sweep_statistics;
+	apr_array_header_t *requestsize_array_rw_sweep;
+	apr_array_header_t *depth_array_rw_sweep;
+	uint64_t rw_sweep_size = 4096;
+	uint32_t rw_sweep_depth = 16;
+	int wal_mode = 0;
+	int wal_commit_writes = 1;
+	apr_time_t wal_commit_interval = 0;
+	apr_array_header_t *requestsize_array_wal;
+	apr_array_header_t *depth_array_wal;
+	apr_array_header_t *discard_percents;
+	apr_array_header_t *requestsize_array_discard;
+	uint64_t discard_granularity = UINT64_C(1024*1024);
+	uint64_t discard_write_size = 4096;
+	apr_array_header_t *requestsize_array_trace;
+	apr_array_header_t *mixed_profiles;
+	struct mixed_profile *mixed_profile;
+	apr_file_t *profile_file;
+	char profile_line[1024];
 
 	apr_pool_t *pool;
 	apr_status_t rv;
 
     apr_getopt_t *opt;
-    int i,optch;
+    int i,j,optch;
 	const char *optarg;
 	char *last, *last2;
 	char *filetoken;
@@ -817,6 +1577,42 @@ int main(int argc, const char * const * argv)
             { "complete", 'c', TRUE, "[-c,--complete=0|1]\n\t\tRun a short (default) or complete test. A short test limits sequential read/write to 128K and random read/write to 4K."},
             { "xmlOutput", 'x', TRUE, "[-x,--xmlOutput=<filename>\n\t\tWrite test results to xml-file. " },
             { "keepFiles", 'k', FALSE, "[-k,--keepFiles\n\t\tDon't delete created files. " },
+            { "engine", 'e', TRUE, "[-e,--engine=<name>]\n\t\tIO engine. libaio (default), io_uring, psync (pread/pwrite thread pool) or mmap on linux. Must be specified before files." },
+            { "buffered", OPT_BUFFERED, TRUE, "[--buffered=0|1]\n\t\tUse the page cache instead of direct IO. Off by default." },
+            { "cacheState", OPT_CACHE_STATE, TRUE, "[--cacheState=cold|warm]\n\t\tBuffered IO: Drop (cold, default) or keep (warm) cached pages of the files between tests." },
+            { "madvise", OPT_MADVISE, TRUE, "[--madvise=<advice>[,<advice>..]]\n\t\tmmap engine: sequential, random and/or hugepage access advice for the mapping. Default is none." },
+            { "polled", OPT_POLLED, TRUE, "[--polled=0|1]\n\t\tBusy-poll for completions. libaio spins on io_getevents, io_uring uses IOPOLL and psync RWF_HIPRI.\n\t\tCosts a core per worker, see the CPU column. Off by default." },
+            { "threadsPerFile", OPT_THREADS_PER_FILE, TRUE, "[--threadsPerFile=<n>]\n\t\tNumber of submitting threads per file, each with its own queue and part of the IO buffer. Default is 1." },
+            { "threadRange", OPT_THREAD_RANGE, TRUE, "[--threadRange=partition|shared]\n\t\tThreads per file use a disjoint part of the file (partition, default) or the whole file (shared)." },
+            { "reapBatch", OPT_REAP_BATCH, TRUE, "[--reapBatch=<n>]\n\t\tMinimum number of completions reaped per blocking wait. Default is 1." },
+            { "numa", OPT_NUMA, TRUE, "[--numa=off|local|remote|compare]\n\t\tBind worker threads and IO buffers to the NUMA node of the device (local), another node (remote)\n\t\tor run every test with both (compare). The node is read from sysfs. Off by default." },
+            { "cpus", OPT_CPUS, TRUE, "[--cpus=<cpu>[,<from>-<to>..]]\n\t\tPin worker threads round-robin to the listed cpus. Takes precedence over --numa for threads." },
+            { "bufferMode", OPT_BUFFER_MODE, TRUE, "[--bufferMode=<mode>[,<mode>..]]\n\t\tIO buffer allocation: hugetlb (explicit huge pages, falls back to normal pages), thp (transparent huge pages),\n\t\tpopulate (prefault before testing) and/or lock (mlock). Default is plain pages. Must be specified before files." },
+            { "skew", OPT_SKEW, TRUE, "[--skew=zipf[:<theta>]|hotspot[:<io%>:<file%>]]\n\t\tAlso run random read/write with skewed offsets. Zipfian (theta defaults to 0.99)\n\t\tor io% of the requests to file% of the file (defaults to 90:10). Off by default." },
+            { "mix", OPT_MIX, TRUE, "[--mix=<key>=<value>[;<key>=<value>..]]\n\t\tRun a mixed workload instead of the Totaliaris mix. May be repeated. Keys are name, read (% reads),\n\t\tseqread/seqwrite (% of reads/writes that are sequential) and random/sequential (size distributions\n\t\tlike 4K:60,8K:30,12K:10). Omitted keys default to the Totaliaris mix.\n\t\t\t--mix=\"name=OLTP;read=70;seqread=0;seqwrite=5;random=8K:80,16K:20\"" },
+            { "mixProfile", OPT_MIX_PROFILE, TRUE, "[--mixProfile=<file>]\n\t\tAs --mix, with one key=value per line read from file. Lines starting with # are ignored." },
+            { "trace", OPT_TRACE, TRUE, "[--trace=<file>]\n\t\tAlso replay a blkparse text or CSV (seconds,R|W,offset,size) trace. Offsets are scaled onto each file." },
+            { "tracePacing", OPT_TRACE_PACING, TRUE, "[--tracePacing=fast|timed]\n\t\tReplay the trace as fast as possible (default) or at its recorded timestamps." },
+            { "segments", OPT_SEGMENTS, TRUE, "[--segments=<n1>[,<n2>..]]\n\t\tSplit every request into n iovecs (preadv/pwritev). Each test is repeated per segment count.\n\t\tDefault is 1 (contiguous). Not supported by the mmap and iocp engines." },
+            { "streams", OPT_STREAMS, TRUE, "[--streams=<n1>[,<n2>..]]\n\t\tAlso run sequential read/write at 128K with n concurrent sequential streams per worker,\n\t\tonce per count, and report throughput relative to the first count. Off by default." },
+            { "streamLayout", OPT_STREAM_LAYOUT, TRUE, "[--streamLayout=region|interleaved]\n\t\tStreams each walk their own region of the file (default) or interleave request by request." },
+            { "streamOrder", OPT_STREAM_ORDER, TRUE, "[--streamOrder=roundrobin|random]\n\t\tEach request continues the next stream in turn (default) or a random stream." },
+            { "wal", OPT_WAL, TRUE, "[--wal=append|overwrite]\n\t\tAlso run a write-ahead log test: small writes made durable with fdatasync, reporting commit latency\n\t\tpercentiles. Records go through the file (append) or rewrite the same blocks (overwrite). Off by default." },
+            { "walCommit", OPT_WAL_COMMIT, TRUE, "[--walCommit=<writes>|<usec>us]\n\t\tWAL test: fdatasync after every n writes, issued concurrently, or every usec microseconds\n\t\tof serial writes (group commit). Default is 1, a sync per write." },
+            { "walSize", OPT_WAL_SIZE, TRUE, "[--walSize=<size>[,<size>..]]\n\t\tWAL test: log write sizes. Default is 4K." },
+            { "discard", OPT_DISCARD, TRUE, "[--discard=<percent>[,<percent>..]]\n\t\tAlso run random region rewrites where percent of the regions are discarded first (BLKDISCARD on devices,\n\t\thole punching on files), once per percentage. Run last, discarded data is not verified. Off by default." },
+            { "discardSize", OPT_DISCARD_SIZE, TRUE, "[--discardSize=<granularity>[:<writesize>]]\n\t\tDiscard test: region size and write size. Default is 1M:4K." },
+            { "simd", OPT_SIMD, TRUE, "[--simd=auto|scalar|sse2|avx2|avx512|bench]\n\t\tKernel generating and verifying the data pattern. Default is auto, the fastest the CPU supports.\n\t\tbench prints the throughput of each kernel and exits." },
+            { "verifyThreads", OPT_VERIFY_THREADS, TRUE, "[--verifyThreads=<n>]\n\t\tVerify reads on a pool of n threads instead of the IO thread. Read buffers return to the queue once\n\t\tverified, device and verification time are reported separately. Default is 0, verify inline." },
+            { "patternPool", OPT_PATTERN_POOL, TRUE, "[--patternPool=<size>]\n\t\tGenerate size bytes of random data per worker once and copy writes from it, stamping only the offset\n\t\tof each sector. Keeps small random writes from being CPU bound, fastest when the pool fits in the CPU\n\t\tcache (for example 256K). Default is off, generate every write." },
+            { "rwSweep", OPT_RW_SWEEP, TRUE, "[--rwSweep=<read%>[,<read%>..]]\n\t\tAlso run random IO mixing reads and writes at each read percentage, for example 0,10,30,50,70,90,100.\n\t\tRead and write latencies per mix are listed in the summary. Off by default." },
+            { "rwSweepIO", OPT_RW_SWEEP_IO, TRUE, "[--rwSweepIO=<size>[:<depth>]]\n\t\tRequest size and queue depth of the --rwSweep tests. Default is 4K:16." },
+            { "workingSet", OPT_WORKING_SET, TRUE, "[--workingSet=<size>[,<size>..]]\n\t\tLimit random read/write to the first size bytes of each worker's range. Each random test is repeated\n\t\tper size, giving throughput and latency versus working set. Default is the whole range." },
+            { "alignment", OPT_ALIGNMENT, TRUE, "[--alignment=<size>[,<size>..]]\n\t\tAlso run random read/write with offsets aligned only to size (a multiple of the sector size) instead of\n\t\tthe request size, for request sizes above it. Results follow the aligned ones. Off by default." },
+            { "patterns", OPT_PATTERNS, TRUE, "[--patterns=<pattern>[,<pattern>..]]\n\t\tAlso run read/write with strided[:<gap>] (skip gap bytes after each request, default 64K),\n\t\treverse (sequential towards the start) and/or butterfly (alternating between both ends) access. Off by default." },
+            { "rate", OPT_RATE, TRUE, "[--rate=<iops1>[,<iops2>..]]\n\t\tOpen loop: offer this many IOPS in total, split over the workers, whether or not earlier IO completed.\n\t\tLatency is measured from the intended issue time. Each test is repeated per rate. Default is closed loop." },
+            { "arrival", OPT_ARRIVAL, TRUE, "[--arrival=fixed|poisson]\n\t\tOpen loop: requests arrive at fixed intervals (default) or as a Poisson process." },
+            { "sqPoll", OPT_SQPOLL, TRUE, "[--sqPoll=0|1]\n\t\tio_uring: Submission queue polled by a kernel thread. Off by default." },
 	        { "help", 'h', FALSE, "[-h --showHelp]\n\t\tShow help" },
 	        { NULL, 0, 0, NULL }, /* end (a.k.a. sentinel) */
 	};
@@ -835,12 +1631,30 @@ int main(int argc, const char * const * argv)
 	options.platform_ops = platform_ops;
 	options.validate_existing = 0;
 	options.write_random = 1;
+    data_pattern_select("auto");
 	options.max_execution_time = apr_time_from_sec(30);
 	options.max_preparation_time = apr_time_from_sec(300);
     options.pool = pool;
     options.xml_output = print_xml_start(pool);
     options.xml_output = print_xml_tag_open(pool, options.xml_output, "diskBench");
     options.keep_files = 0;
+    options.buffered = 0;
+    options.cold_cache = 1;
+    options.map_advice = 0;
+    options.sqpoll = 0;
+    options.reap_batch = 1;
+    options.polled = 0;
+    options.numa_mode = NUMA_OFF;
+    options.buffer_flags = 0;
+    options.io_segments = 1;
+    options.sector_size = 512;
+    options.target_iops = 0.0;
+    options.arrival = ARRIVAL_FIXED;
+    options.working_set = 0;
+    options.commit_writes = 0;
+    options.commit_interval = 0;
+    options.verify_pool = NULL;
+    options.pattern_pool_size = 0;
 
     quick = 1;
 
@@ -852,7 +1666,27 @@ int main(int argc, const char * const * argv)
 	requestsize_array_create = apr_array_make(pool, 0, sizeof(uint64_t));
 	requestsize_array_random = apr_array_make(pool, 0, sizeof(uint64_t));
 	requestsize_array_sequential = apr_array_make(pool, 0, sizeof(uint64_t));
+	requestsize_array_trace = apr_array_make(pool, 0, sizeof(uint64_t));
+	requestsize_array_streams = apr_array_make(pool, 0, sizeof(uint64_t));
+	stream_counts = apr_array_make(pool, 0, sizeof(int));
+	pattern_array = apr_array_make(pool, 0, sizeof(int));
+	alignment_array = apr_array_make(pool, 0, sizeof(uint64_t));
+	requestsize_array_unaligned = apr_array_make(pool, 0, sizeof(uint64_t));
+	mixed_profiles = apr_array_make(pool, 0, sizeof(struct mixed_profile*));
 	options.statistics_array = apr_array_make(pool, 0, sizeof(struct io_statistics*));
+	cpu_array = apr_array_make(pool, 0, sizeof(int));
+	options.io_segments_array = apr_array_make(pool, 0, sizeof(int));
+	options.rate_array = apr_array_make(pool, 0, sizeof(double));
+	options.working_set_array = apr_array_make(pool, 0, sizeof(uint64_t));
+	working_sets = apr_array_make(pool, 0, sizeof(uint64_t));
+	rw_sweep_reads = apr_array_make(pool, 0, sizeof(int));
+	rw_sweep_statistics = apr_array_make(pool, 0, sizeof(struct io_statistics*));
+	requestsize_array_rw_sweep = apr_array_make(pool, 0, sizeof(uint64_t));
+	depth_array_rw_sweep = apr_array_make(pool, 0, sizeof(uint32_t));
+	requestsize_array_wal = apr_array_make(pool, 0, sizeof(uint64_t));
+	depth_array_wal = apr_array_make(pool, 0, sizeof(uint32_t));
+	discard_percents = apr_array_make(pool, 0, sizeof(int));
+	requestsize_array_discard = apr_array_make(pool, 0, sizeof(uint64_t));
 
     /* parse the all options based on opt_option[] */
     while ((rv = apr_getopt_long(opt, opt_option, &optch, &optarg)) == APR_SUCCESS) {
@@ -889,6 +1723,7 @@ int main(int argc, const char * const * argv)
 			break;
         case 's':
             sector_size = parse_size(optarg);
+            options.sector_size = sector_size;
 			break;
         case 'q':
             last = apr_strtok(apr_pstrdup(pool,optarg), ",", &last2);
@@ -931,6 +1766,400 @@ int main(int argc, const char * const * argv)
         case 'k':
             options.keep_files = 1;
             break;
+        case 'e':
+            platform_ops = platform_ops_lookup(optarg);
+            if(platform_ops == NULL) {
+                printf("Unknown IO engine %s\n", optarg);
+                return 1;
+            }
+            options.platform_ops = platform_ops;
+            /* mapped files always go through the page cache */
+            if(strcmp(platform_ops->name, "mmap") == 0) {
+                options.buffered = 1;
+            }
+            break;
+        case OPT_SQPOLL:
+            options.sqpoll = atoi(optarg);
+            break;
+        case OPT_BUFFERED:
+            options.buffered = atoi(optarg);
+            break;
+        case OPT_CACHE_STATE:
+            if(strcmp(optarg, "cold") == 0) {
+                options.cold_cache = 1;
+            } else if(strcmp(optarg, "warm") == 0) {
+                options.cold_cache = 0;
+            } else {
+                printf("Unknown cache state %s\n", optarg);
+                return 1;
+            }
+            break;
+        case OPT_MADVISE:
+            last = apr_strtok(apr_pstrdup(pool,optarg), ",", &last2);
+            while(last != NULL) {
+                if(strcmp(last, "sequential") == 0) {
+                    options.map_advice |= MAP_ADVICE_SEQUENTIAL;
+                } else if(strcmp(last, "random") == 0) {
+                    options.map_advice |= MAP_ADVICE_RANDOM;
+                } else if(strcmp(last, "hugepage") == 0) {
+                    options.map_advice |= MAP_ADVICE_HUGEPAGE;
+                } else {
+                    printf("Unknown madvise advice %s\n", last);
+                    return 1;
+                }
+                last = apr_strtok(NULL, ",", &last2);
+            }
+            break;
+        case OPT_POLLED:
+            options.polled = atoi(optarg);
+            break;
+        case OPT_THREADS_PER_FILE:
+            threads_per_file = atoi(optarg);
+            if(threads_per_file < 1)
+                threads_per_file = 1;
+            break;
+        case OPT_THREAD_RANGE:
+            if(strcmp(optarg, "partition") == 0) {
+                shared_range = 0;
+            } else if(strcmp(optarg, "shared") == 0) {
+                shared_range = 1;
+            } else {
+                printf("Unknown thread range %s\n", optarg);
+                return 1;
+            }
+            break;
+        case OPT_NUMA:
+            if(strcmp(optarg, "off") == 0) {
+                options.numa_mode = NUMA_OFF;
+            } else if(strcmp(optarg, "local") == 0) {
+                options.numa_mode = NUMA_LOCAL;
+            } else if(strcmp(optarg, "remote") == 0) {
+                options.numa_mode = NUMA_REMOTE;
+            } else if(strcmp(optarg, "compare") == 0) {
+                options.numa_mode = NUMA_COMPARE;
+            } else {
+                printf("Unknown NUMA placement %s\n", optarg);
+                return 1;
+            }
+            break;
+        case OPT_CPUS:
+            last = apr_strtok(apr_pstrdup(pool,optarg), ",", &last2);
+            while(last != NULL) {
+                int from, to;
+                if(sscanf(last, "%d-%d", &from, &to) != 2) {
+                    from = to = atoi(last);
+                }
+                if(from < 0 || to < from) {
+                    printf("Invalid cpu %s\n", last);
+                    return 1;
+                }
+                for(; from <= to; ++from) {
+                    APR_ARRAY_PUSH(cpu_array, int) = from;
+                }
+                last = apr_strtok(NULL, ",", &last2);
+            }
+            break;
+        case OPT_BUFFER_MODE:
+            last = apr_strtok(apr_pstrdup(pool,optarg), ",", &last2);
+            while(last != NULL) {
+                if(strcmp(last, "hugetlb") == 0) {
+                    options.buffer_flags |= IO_BUFFER_HUGETLB;
+                } else if(strcmp(last, "thp") == 0) {
+                    options.buffer_flags |= IO_BUFFER_THP;
+                } else if(strcmp(last, "populate") == 0) {
+                    options.buffer_flags |= IO_BUFFER_POPULATE;
+                } else if(strcmp(last, "lock") == 0) {
+                    options.buffer_flags |= IO_BUFFER_LOCK;
+                } else {
+                    printf("Unknown buffer mode %s\n", last);
+                    return 1;
+                }
+                last = apr_strtok(NULL, ",", &last2);
+            }
+            break;
+        case OPT_SKEW:
+            last = apr_strtok(apr_pstrdup(pool,optarg), ":", &last2);
+            if(last != NULL && strcmp(last, "zipf") == 0) {
+                skew_distribution = SKEW_ZIPF;
+                last = apr_strtok(NULL, ":", &last2);
+                skew_param1 = last != NULL ? atof(last) : 0.99;
+                skew_description = apr_psprintf(pool, "Zipf %.2f", skew_param1);
+            } else if(last != NULL && strcmp(last, "hotspot") == 0) {
+                skew_distribution = SKEW_HOTSPOT;
+                last = apr_strtok(NULL, ":", &last2);
+                skew_param1 = last != NULL ? atof(last) : 90.0;
+                last = apr_strtok(NULL, ":", &last2);
+                skew_param2 = last != NULL ? atof(last) : 10.0;
+                skew_description = apr_psprintf(pool, "Hot %.0f/%.0f", skew_param1, skew_param2);
+                skew_param1 /= 100.0;
+                skew_param2 /= 100.0;
+            } else {
+                printf("Unknown skew %s\n", optarg);
+                return 1;
+            }
+            if((skew_distribution == SKEW_ZIPF && (skew_param1 <= 0.0 || skew_param1 >= 1.0))
+                    || (skew_distribution == SKEW_HOTSPOT && (skew_param1 < 0.0 || skew_param1 > 1.0
+                                                              || skew_param2 <= 0.0 || skew_param2 > 1.0))) {
+                printf("Invalid skew parameters %s\n", optarg);
+                return 1;
+            }
+            break;
+        case OPT_MIX:
+            mixed_profile = apr_palloc(pool, sizeof(struct mixed_profile));
+            mixed_profile_default(mixed_profile);
+            mixed_profile->name = apr_psprintf(pool, "Mix %d", mixed_profiles->nelts + 1);
+            last = apr_strtok(apr_pstrdup(pool,optarg), ";", &last2);
+            while(last != NULL) {
+                if(!parse_mixed_profile_setting(pool, last, mixed_profile)) {
+                    printf("Invalid mix setting %s\n", last);
+                    return 1;
+                }
+                last = apr_strtok(NULL, ";", &last2);
+            }
+            APR_ARRAY_PUSH(mixed_profiles, struct mixed_profile*) = mixed_profile;
+            break;
+        case OPT_MIX_PROFILE:
+            if(apr_file_open(&profile_file, optarg, APR_READ, 0, pool) != APR_SUCCESS) {
+                printf("Could not open mix profile %s\n", optarg);
+                return 1;
+            }
+            mixed_profile = apr_palloc(pool, sizeof(struct mixed_profile));
+            mixed_profile_default(mixed_profile);
+            mixed_profile->name = apr_psprintf(pool, "Mix %d", mixed_profiles->nelts + 1);
+            while(apr_file_gets(profile_line, sizeof(profile_line), profile_file) == APR_SUCCESS) {
+                last = apr_strtok(profile_line, " \t\r\n", &last2);
+                if(last == NULL || *last == '#')
+                    continue;
+                if(!parse_mixed_profile_setting(pool, last, mixed_profile)) {
+                    printf("Invalid mix setting %s in %s\n", last, optarg);
+                    return 1;
+                }
+            }
+            apr_file_close(profile_file);
+            APR_ARRAY_PUSH(mixed_profiles, struct mixed_profile*) = mixed_profile;
+            break;
+        case OPT_TRACE:
+            trace_filename = optarg;
+            break;
+        case OPT_TRACE_PACING:
+            if(strcmp(optarg, "fast") == 0) {
+                trace_timed = 0;
+            } else if(strcmp(optarg, "timed") == 0) {
+                trace_timed = 1;
+            } else {
+                printf("Unknown trace pacing %s\n", optarg);
+                return 1;
+            }
+            break;
+        case OPT_SEGMENTS:
+            last = apr_strtok(apr_pstrdup(pool,optarg), ",", &last2);
+            while(last != NULL) {
+                i = atoi(last);
+                if(i < 1 || i > MAX_IO_SEGMENTS) {
+                    printf("Segment count must be between 1 and %d\n", MAX_IO_SEGMENTS);
+                    return 1;
+                }
+                APR_ARRAY_PUSH(options.io_segments_array, int) = i;
+                last = apr_strtok(NULL, ",", &last2);
+            }
+            break;
+        case OPT_STREAMS:
+            last = apr_strtok(apr_pstrdup(pool,optarg), ",", &last2);
+            while(last != NULL) {
+                i = atoi(last);
+                if(i < 1 || i > MAX_STREAMS) {
+                    printf("Stream count must be between 1 and %d\n", MAX_STREAMS);
+                    return 1;
+                }
+                APR_ARRAY_PUSH(stream_counts, int) = i;
+                last = apr_strtok(NULL, ",", &last2);
+            }
+            break;
+        case OPT_STREAM_LAYOUT:
+            if(strcmp(optarg, "region") == 0) {
+                stream_layout = STREAMS_REGION;
+            } else if(strcmp(optarg, "interleaved") == 0) {
+                stream_layout = STREAMS_INTERLEAVED;
+            } else {
+                printf("Unknown stream layout %s\n", optarg);
+                return 1;
+            }
+            break;
+        case OPT_STREAM_ORDER:
+            if(strcmp(optarg, "roundrobin") == 0) {
+                stream_order = STREAMS_ROUND_ROBIN;
+            } else if(strcmp(optarg, "random") == 0) {
+                stream_order = STREAMS_RANDOM;
+            } else {
+                printf("Unknown stream order %s\n", optarg);
+                return 1;
+            }
+            break;
+        case OPT_WAL:
+            if(strcmp(optarg, "append") == 0) {
+                wal_mode = WAL_APPEND;
+            } else if(strcmp(optarg, "overwrite") == 0) {
+                wal_mode = WAL_OVERWRITE;
+            } else {
+                printf("Unknown WAL mode %s\n", optarg);
+                return 1;
+            }
+            break;
+        case OPT_WAL_COMMIT:
+            i = atoi(optarg);
+            if(i < 1 || (strstr(optarg, "us") == NULL && i > MAX_QUEUE_SIZE)) {
+                printf("Invalid WAL commit %s\n", optarg);
+                return 1;
+            }
+            if(strstr(optarg, "us") != NULL) {
+                wal_commit_writes = 0;
+                wal_commit_interval = i;
+            } else {
+                wal_commit_writes = i;
+                wal_commit_interval = 0;
+            }
+            break;
+        case OPT_WAL_SIZE:
+            last = apr_strtok(apr_pstrdup(pool,optarg), ",", &last2);
+            while(last != NULL) {
+                APR_ARRAY_PUSH(requestsize_array_wal, uint64_t) = parse_size(last);
+                last = apr_strtok(NULL, ",", &last2);
+            }
+            break;
+        case OPT_DISCARD:
+            last = apr_strtok(apr_pstrdup(pool,optarg), ",", &last2);
+            while(last != NULL) {
+                i = atoi(last);
+                if(i < 0 || i > 100) {
+                    printf("Discard percentage must be between 0 and 100\n");
+                    return 1;
+                }
+                APR_ARRAY_PUSH(discard_percents, int) = i;
+                last = apr_strtok(NULL, ",", &last2);
+            }
+            break;
+        case OPT_PATTERN_POOL:
+            options.pattern_pool_size = parse_size(optarg);
+            if(options.pattern_pool_size < 512 || options.pattern_pool_size % 512 != 0) {
+                printf("Pattern pool size must be a multiple of 512 bytes\n");
+                return 1;
+            }
+            break;
+        case OPT_VERIFY_THREADS:
+            verify_threads = atoi(optarg);
+            if(verify_threads < 0) {
+                printf("Invalid number of verify threads %s\n", optarg);
+                return 1;
+            }
+            break;
+        case OPT_SIMD:
+            if(strcmp(optarg, "bench") == 0) {
+                data_pattern_benchmark();
+                return 0;
+            }
+            if(!data_pattern_select(optarg)) {
+                printf("Unknown or unsupported pattern kernel %s\n", optarg);
+                return 1;
+            }
+            break;
+        case OPT_DISCARD_SIZE:
+            last = apr_strtok(apr_pstrdup(pool,optarg), ":", &last2);
+            if(last != NULL)
+                discard_granularity = parse_size(last);
+            last = apr_strtok(NULL, ":", &last2);
+            if(last != NULL)
+                discard_write_size = parse_size(last);
+            if(discard_granularity == 0 || discard_write_size == 0) {
+                printf("Invalid discard size %s\n", optarg);
+                return 1;
+            }
+            break;
+        case OPT_RW_SWEEP:
+            last = apr_strtok(apr_pstrdup(pool,optarg), ",", &last2);
+            while(last != NULL) {
+                i = atoi(last);
+                if(i < 0 || i > 100) {
+                    printf("Read percentage must be between 0 and 100\n");
+                    return 1;
+                }
+                APR_ARRAY_PUSH(rw_sweep_reads, int) = i;
+                last = apr_strtok(NULL, ",", &last2);
+            }
+            break;
+        case OPT_RW_SWEEP_IO:
+            last = apr_strtok(apr_pstrdup(pool,optarg), ":", &last2);
+            if(last != NULL)
+                rw_sweep_size = parse_size(last);
+            last = apr_strtok(NULL, ":", &last2);
+            if(last != NULL)
+                rw_sweep_depth = atoi(last);
+            if(rw_sweep_size == 0 || rw_sweep_depth < 1 || rw_sweep_depth > MAX_QUEUE_SIZE) {
+                printf("Invalid read/write sweep IO %s\n", optarg);
+                return 1;
+            }
+            break;
+        case OPT_WORKING_SET:
+            last = apr_strtok(apr_pstrdup(pool,optarg), ",", &last2);
+            while(last != NULL) {
+                if(parse_size(last) == 0) {
+                    printf("Invalid working set %s\n", last);
+                    return 1;
+                }
+                APR_ARRAY_PUSH(working_sets, uint64_t) = parse_size(last);
+                last = apr_strtok(NULL, ",", &last2);
+            }
+            break;
+        case OPT_ALIGNMENT:
+            last = apr_strtok(apr_pstrdup(pool,optarg), ",", &last2);
+            while(last != NULL) {
+                APR_ARRAY_PUSH(alignment_array, uint64_t) = parse_size(last);
+                last = apr_strtok(NULL, ",", &last2);
+            }
+            break;
+        case OPT_PATTERNS:
+            last = apr_strtok(apr_pstrdup(pool,optarg), ",", &last2);
+            while(last != NULL) {
+                if(strncmp(last, "strided", 7) == 0 && (last[7] == '\0' || last[7] == ':')) {
+                    APR_ARRAY_PUSH(pattern_array, int) = PATTERN_STRIDED;
+                    if(last[7] == ':')
+                        stride_gap = parse_size(last + 8);
+                } else if(strcmp(last, "reverse") == 0) {
+                    APR_ARRAY_PUSH(pattern_array, int) = PATTERN_REVERSE;
+                } else if(strcmp(last, "butterfly") == 0) {
+                    APR_ARRAY_PUSH(pattern_array, int) = PATTERN_BUTTERFLY;
+                } else {
+                    printf("Unknown access pattern %s\n", last);
+                    return 1;
+                }
+                last = apr_strtok(NULL, ",", &last2);
+            }
+            break;
+        case OPT_RATE:
+            last = apr_strtok(apr_pstrdup(pool,optarg), ",", &last2);
+            while(last != NULL) {
+                if(atof(last) <= 0.0) {
+                    printf("Invalid rate %s\n", last);
+                    return 1;
+                }
+                APR_ARRAY_PUSH(options.rate_array, double) = atof(last);
+                last = apr_strtok(NULL, ",", &last2);
+            }
+            break;
+        case OPT_ARRIVAL:
+            if(strcmp(optarg, "fixed") == 0) {
+                options.arrival = ARRIVAL_FIXED;
+            } else if(strcmp(optarg, "poisson") == 0) {
+                options.arrival = ARRIVAL_POISSON;
+            } else {
+                printf("Unknown arrival process %s\n", optarg);
+                return 1;
+            }
+            break;
+        case OPT_REAP_BATCH:
+            options.reap_batch = atoi(optarg);
+            if(options.reap_batch < 1)
+                options.reap_batch = 1;
+            break;
         case 'h':
         	show_help(opt_option);
         	return 1;
@@ -939,6 +2168,44 @@ int main(int argc, const char * const * argv)
         }
     }
 
+    for(j=0; j < mixed_profiles->nelts; ++j) {
+        mixed_profile = APR_ARRAY_IDX(mixed_profiles, j, struct mixed_profile*);
+        if(!size_distribution_aligned(&mixed_profile->random_sizes, sector_size)
+                || !size_distribution_aligned(&mixed_profile->sequential_sizes, sector_size)) {
+            printf("Request sizes of mix %s must be multiples of the sector size %u\n", mixed_profile->name, sector_size);
+            return 1;
+        }
+    }
+
+    for(j=0; j < requestsize_array_wal->nelts; ++j) {
+        if(APR_ARRAY_IDX(requestsize_array_wal, j, uint64_t) == 0 || APR_ARRAY_IDX(requestsize_array_wal, j, uint64_t) % sector_size != 0) {
+            printf("WAL write size must be a multiple of the sector size %u\n", sector_size);
+            return 1;
+        }
+    }
+
+    if(discard_write_size % sector_size != 0 || discard_granularity % discard_write_size != 0) {
+        printf("Discard write size must be a multiple of the sector size %u and divide the discard granularity\n", sector_size);
+        return 1;
+    }
+
+    if(rw_sweep_size % sector_size != 0) {
+        printf("Read/write sweep request size must be a multiple of the sector size %u\n", sector_size);
+        return 1;
+    }
+
+    if(stride_gap % sector_size != 0) {
+        printf("Stride gap must be a multiple of the sector size %u\n", sector_size);
+        return 1;
+    }
+
+    for(j=0; j < alignment_array->nelts; ++j) {
+        if(APR_ARRAY_IDX(alignment_array, j, uint64_t) == 0 || APR_ARRAY_IDX(alignment_array, j, uint64_t) % sector_size != 0) {
+            printf("Alignment must be a multiple of the sector size %u\n", sector_size);
+            return 1;
+        }
+    }
+
     if(worker_array->nelts == 0) {
         rv = create_worker("diskBench.dat", &options,
                     UINT64_C(32*1024*1024),
@@ -959,6 +2226,26 @@ int main(int argc, const char * const * argv)
     	return 1;
     }
 
+    if(verify_threads > 0) {
+        rv = verify_pool_create(&options.verify_pool, verify_threads, pool);
+        if(rv != APR_SUCCESS) {
+            printf("Error creating verify threads\n");
+            return 1;
+        }
+    }
+
+    if(options.pattern_pool_size > 0) {
+        for(i=0; i < worker_array->nelts; ++i) {
+            worker = APR_ARRAY_IDX(worker_array, i, struct io_worker*);
+            worker->pattern_pool = data_pattern_pool_create(options.pattern_pool_size, &worker->random_seed);
+            if(worker->pattern_pool == NULL) {
+                printf("Could not allocate pattern pool for %s\n", worker->filename);
+                return 1;
+            }
+            worker->pattern_pool_sectors = options.pattern_pool_size / DATA_PATTERN_SECTOR;
+        }
+    }
+
     workers = calloc(worker_array->nelts, sizeof(struct io_worker*));
 
     options.xml_output = print_xml_tag_open(pool, options.xml_output, "prepare_and_validate");
@@ -987,6 +2274,10 @@ int main(int argc, const char * const * argv)
 	        workers[i]->filesize = workers[0]->filesize;
 	    }
         open_worker(workers[i], 0.8/worker_array->nelts);
+        if(options.platform_ops->file_numa_node != NULL) {
+            rv = options.platform_ops->file_numa_node(workers[i]->file, &(workers[i]->device_node));
+            assert(rv == APR_SUCCESS);
+        }
 	    workers[i]->description =
             apr_psprintf(pool,"%s;%s;%s",workers[i]->filename,
                 print_size(pool, "%.0f%cB", workers[i]->filesize, 1024),
@@ -1009,7 +2300,14 @@ int main(int argc, const char * const * argv)
             }
         }
     }
-    run_tests("Creating/Validating files", &options, workers,
+    if(options.numa_mode == NUMA_COMPARE && options.platform_ops->get_numa_nodes != NULL
+            && options.platform_ops->get_numa_nodes() < 2) {
+        printf("Single NUMA node, comparing placement is not possible. Using local placement.\n");
+        options.numa_mode = NUMA_LOCAL;
+    }
+    /* files are prepared with local placement when comparing */
+    place_workers(workers, worker_array->nelts, options.numa_mode == NUMA_COMPARE ? NUMA_LOCAL : options.numa_mode);
+    run_placed_tests("Creating/Validating files", &options, workers,
               worker_array->nelts, auto_terminate_request, auto_terminate_depth, NULL, 0, NULL);
     for(i=0; i < worker_array->nelts; ++i) {
         workers[i]->options->max_execution_time = max_execution_time;
@@ -1024,6 +2322,28 @@ int main(int argc, const char * const * argv)
 
     options.xml_output = print_xml_tag_close(pool, options.xml_output, "prepare_and_validate");
 
+    /* Split prepared files between submitting threads */
+    if(threads_per_file > 1) {
+        test_worker_count = worker_array->nelts * threads_per_file;
+        test_workers = calloc(test_worker_count, sizeof(struct io_worker*));
+        for(i=0; i < worker_array->nelts; ++i) {
+            rv = create_worker_threads(workers[i], threads_per_file, shared_range, test_workers + i*threads_per_file);
+            if(rv != APR_SUCCESS) {
+                printf("IO buffer of %s too small for %d threads\n", workers[i]->filename, threads_per_file);
+                return 1;
+            }
+        }
+    } else {
+        test_worker_count = worker_array->nelts;
+        test_workers = workers;
+    }
+    if(options.numa_mode != NUMA_COMPARE) {
+        place_workers(test_workers, test_worker_count, options.numa_mode);
+    }
+    for(i=0; i < test_worker_count && cpu_array->nelts > 0; ++i) {
+        test_workers[i]->cpu = APR_ARRAY_IDX(cpu_array, i % cpu_array->nelts, int);
+    }
+
     options.xml_output = print_xml_tag_open(pool, options.xml_output, "tests");
 
     printf("\n");
@@ -1044,7 +2364,7 @@ int main(int argc, const char * const * argv)
         }
         else {
             i=sector_size;
-            while(i <= iobufsize/worker_array->nelts) {
+            while(i <= iobufsize/test_worker_count) {
                 APR_ARRAY_PUSH(requestsize_array_random, uint64_t) = i;
                 APR_ARRAY_PUSH(requestsize_array_sequential, uint64_t)  =  i;
                 i = i*2;
@@ -1055,10 +2375,10 @@ int main(int argc, const char * const * argv)
 
     rv = sequential_request_generator_factory(&workload, 1);
     assert(rv == APR_SUCCESS);
-    for(i=0; i < worker_array->nelts; ++i) {
-        prepare_workload(workers[i], workload, requestsize_array_sequential, queue_depth_array);
+    for(i=0; i < test_worker_count; ++i) {
+        prepare_workload(test_workers[i], workload, requestsize_array_sequential, queue_depth_array);
     }
-    run_tests("Sequential write", &options, workers, worker_array->nelts,
+    run_tests("Sequential write", &options, test_workers, test_worker_count,
                auto_terminate_request,
                auto_terminate_depth,
                &max_requestsize_sequential,
@@ -1066,51 +2386,291 @@ int main(int argc, const char * const * argv)
 
     rv = sequential_request_generator_factory(&workload, 0);
     assert(rv == APR_SUCCESS);
-    for(i=0; i < worker_array->nelts; ++i) {
-        prepare_workload(workers[i], workload, requestsize_array_sequential, queue_depth_array);
+    for(i=0; i < test_worker_count; ++i) {
+        prepare_workload(test_workers[i], workload, requestsize_array_sequential, queue_depth_array);
     }
-    run_tests("Sequential read", &options, workers, worker_array->nelts,
+    run_tests("Sequential read", &options, test_workers, test_worker_count,
                auto_terminate_request,
                auto_terminate_depth,
                &max_requestsize_sequential,
                 128*1024, "Sequential read 128k");
 
-    rv = random_request_generator_factory(&workload, 1);
-    assert(rv == APR_SUCCESS);
-    for(i=0; i < worker_array->nelts; ++i) {
-        prepare_workload(workers[i], workload, requestsize_array_random, queue_depth_array);
+    /* Stream scaling, throughput relative to the first stream count */
+    if(stream_counts->nelts > 0) {
+        uint64_t reqsize_streams = UINT64_C(128*1024);
+        if(reqsize_streams > test_workers[0]->bufsize)
+            reqsize_streams = test_workers[0]->bufsize;
+        APR_ARRAY_PUSH(requestsize_array_streams, uint64_t) = reqsize_streams;
+    }
+    for(write=1; write >= 0 && stream_counts->nelts > 0; --write) {
+        baseline_throughput = 0.0;
+        for(j=0; j < stream_counts->nelts; ++j) {
+            int streams = APR_ARRAY_IDX(stream_counts, j, int);
+            rv = multistream_request_generator_factory(&workload, write, streams, stream_layout, stream_order);
+            assert(rv == APR_SUCCESS);
+            for(i=0; i < test_worker_count; ++i) {
+                prepare_workload(test_workers[i], workload, requestsize_array_streams, queue_depth_array);
+            }
+            first_statistics = options.statistics_array->nelts;
+            run_tests(apr_psprintf(pool, "Sequential %s %dx", write ? "write" : "read", streams),
+                       &options, test_workers, test_worker_count,
+                       0,
+                       auto_terminate_depth,
+                       NULL,
+                       0, NULL);
+
+            stream_throughput = 0.0;
+            for(i=first_statistics; i < options.statistics_array->nelts; ++i) {
+                struct io_statistics *stream_statistics = APR_ARRAY_IDX(options.statistics_array, i, struct io_statistics*);
+                if(stream_statistics->max_throughput > stream_throughput)
+                    stream_throughput = stream_statistics->max_throughput;
+            }
+            if(j == 0)
+                baseline_throughput = stream_throughput;
+            if(j > 0 && baseline_throughput > 0.0) {
+                printf("%-25s  %9s  %8s  %12s\n",
+                apr_psprintf(pool, "  %.0f%% of %dx", 100.0*stream_throughput/baseline_throughput,
+                             APR_ARRAY_IDX(stream_counts, 0, int)),
+                "",
+                "",
+                print_size(pool, THROUGHPUT_FMT, stream_throughput, K));
+            }
+        }
     }
-    run_tests("Random write", &options, workers, worker_array->nelts,
-               auto_terminate_request,
-               auto_terminate_depth,
-               &max_requestsize_random,
-               4096, "Random write 4k");
 
-    rv = random_request_generator_factory(&workload, 0);
-    assert(rv == APR_SUCCESS);
-    for(i=0; i < worker_array->nelts; ++i) {
-        prepare_workload(workers[i], workload, requestsize_array_random, queue_depth_array);
+    for(j=0; j < pattern_array->nelts; ++j) {
+        int pattern = APR_ARRAY_IDX(pattern_array, j, int);
+        if(pattern == PATTERN_STRIDED) {
+            for(i=0; i < test_worker_count; ++i) {
+                if(stride_gap >= test_workers[i]->filesize)
+                    break;
+            }
+            if(i < test_worker_count) {
+                printf("Stride gap %s does not fit in %s of %s, strided test skipped\n",
+                       print_size(pool, "%.0f%cB", stride_gap, K), test_workers[i]->filename,
+                       print_size(pool, "%.0f%cB", test_workers[i]->filesize, K));
+                continue;
+            }
+            pattern_description = apr_psprintf(pool, "Strided %s", print_size(pool, "%.0f%cB", stride_gap, K));
+        } else {
+            pattern_description = pattern == PATTERN_REVERSE ? "Reverse" : "Butterfly";
+        }
+        for(write=1; write >= 0; --write) {
+            rv = pattern_request_generator_factory(&workload, write, pattern, stride_gap);
+            assert(rv == APR_SUCCESS);
+            for(i=0; i < test_worker_count; ++i) {
+                prepare_workload(test_workers[i], workload, requestsize_array_sequential, queue_depth_array);
+            }
+            run_tests(apr_pstrcat(pool, pattern_description, write ? " write" : " read", NULL),
+                       &options, test_workers, test_worker_count,
+                       auto_terminate_request,
+                       auto_terminate_depth,
+                       NULL,
+                       128*1024, apr_pstrcat(pool, pattern_description, write ? " write 128k" : " read 128k", NULL));
+        }
+    }
+
+    /* Only uniform random IO is limited to and swept over the working sets */
+    options.working_set_array = working_sets;
+    for(write=1; write >= 0; --write) {
+        rv = random_request_generator_factory(&workload, write);
+        assert(rv == APR_SUCCESS);
+        for(i=0; i < test_worker_count; ++i) {
+            prepare_workload(test_workers[i], workload, requestsize_array_random, queue_depth_array);
+        }
+        run_tests(write ? "Random write" : "Random read", &options, test_workers, test_worker_count,
+                   auto_terminate_request,
+                   auto_terminate_depth,
+                   &max_requestsize_random,
+                   4096, write ? "Random write 4k" : "Random read 4k");
+
+        /* Same sizes with offsets off the request size grid, next to the aligned results */
+        for(j=0; j < alignment_array->nelts; ++j) {
+            uint64_t alignment = APR_ARRAY_IDX(alignment_array, j, uint64_t);
+            char *alignment_description = apr_psprintf(pool, " %s aligned", print_size(pool, "%.0f%cB", alignment, K));
+
+            apr_array_clear(requestsize_array_unaligned);
+            for(i=0; i < requestsize_array_random->nelts; ++i) {
+                if(APR_ARRAY_IDX(requestsize_array_random, i, uint64_t) > alignment)
+                    APR_ARRAY_PUSH(requestsize_array_unaligned, uint64_t) = APR_ARRAY_IDX(requestsize_array_random, i, uint64_t);
+            }
+            if(requestsize_array_unaligned->nelts == 0)
+                continue;
+            rv = random_request_generator_aligned_factory(&workload, write, alignment);
+            assert(rv == APR_SUCCESS);
+            for(i=0; i < test_worker_count; ++i) {
+                prepare_workload(test_workers[i], workload, requestsize_array_unaligned, queue_depth_array);
+            }
+            run_tests(apr_pstrcat(pool, write ? "Random write" : "Random read", alignment_description, NULL),
+                       &options, test_workers, test_worker_count,
+                       auto_terminate_request,
+                       auto_terminate_depth,
+                       NULL,
+                       0, NULL);
+        }
+    }
+    options.working_set_array = apr_array_make(pool, 0, sizeof(uint64_t));
+
+    if(skew_distribution != 0) {
+        rv = skewed_request_generator_factory(&workload, 1, skew_distribution, skew_param1, skew_param2);
+        assert(rv == APR_SUCCESS);
+        for(i=0; i < test_worker_count; ++i) {
+            prepare_workload(test_workers[i], workload, requestsize_array_random, queue_depth_array);
+        }
+        run_tests(apr_pstrcat(pool, skew_description, " write", NULL), &options, test_workers, test_worker_count,
+                   auto_terminate_request,
+                   auto_terminate_depth,
+                   &max_requestsize_random,
+                   4096, apr_pstrcat(pool, skew_description, " write 4k", NULL));
+
+        rv = skewed_request_generator_factory(&workload, 0, skew_distribution, skew_param1, skew_param2);
+        assert(rv == APR_SUCCESS);
+        for(i=0; i < test_worker_count; ++i) {
+            prepare_workload(test_workers[i], workload, requestsize_array_random, queue_depth_array);
+        }
+        run_tests(apr_pstrcat(pool, skew_description, " read", NULL), &options, test_workers, test_worker_count,
+                   auto_terminate_request,
+                   auto_terminate_depth,
+                   &max_requestsize_random,
+                    4096, apr_pstrcat(pool, skew_description, " read 4k", NULL));
     }
-    run_tests("Random read", &options, workers, worker_array->nelts,
-               auto_terminate_request,
-               auto_terminate_depth,
-               &max_requestsize_random,
-                4096, "Random read 4k");
 
 	char *sequential_requestsizes = print_array_size(pool, max_requestsize_sequential, requestsize_array_sequential);
 	char *random_requestsizes = print_array_size(pool, max_requestsize_random, requestsize_array_random);
 
-    rv = mixed_request_generator_factory(&workload, 1);
+    if(mixed_profiles->nelts == 0) {
+        mixed_profile = apr_palloc(pool, sizeof(struct mixed_profile));
+        mixed_profile_default(mixed_profile);
+        APR_ARRAY_PUSH(mixed_profiles, struct mixed_profile*) = mixed_profile;
+    }
     apr_array_clear(requestsize_array_random);
     APR_ARRAY_PUSH(requestsize_array_random, uint64_t) = (uint64_t) sector_size;
-    for(i=0; i < worker_array->nelts; ++i) {
-        prepare_workload(workers[i], workload, requestsize_array_random, queue_depth_array);
+    for(j=0; j < mixed_profiles->nelts; ++j) {
+        mixed_profile = APR_ARRAY_IDX(mixed_profiles, j, struct mixed_profile*);
+        rv = mixed_request_generator_factory(&workload, mixed_profile);
+        assert(rv == APR_SUCCESS);
+        for(i=0; i < test_worker_count; ++i) {
+            prepare_workload(test_workers[i], workload, requestsize_array_random, queue_depth_array);
+        }
+        run_tests(mixed_profile->name, &options, test_workers, test_worker_count,
+                   auto_terminate_request,
+                   auto_terminate_depth,
+                   NULL,
+                   0, NULL);
+    }
+
+    /* Read/write mix curve at one request size and depth */
+    APR_ARRAY_PUSH(requestsize_array_rw_sweep, uint64_t) = rw_sweep_size;
+    APR_ARRAY_PUSH(depth_array_rw_sweep, uint32_t) = rw_sweep_depth;
+    if(rw_sweep_reads->nelts > 0 && rw_sweep_size > max_request_at_depth(test_workers, test_worker_count, rw_sweep_depth)) {
+        printf("Read/write sweep: %s requests at depth %u do not fit in the IO buffer, sweep skipped\n",
+               print_size(pool, "%.0f%cB", rw_sweep_size, K), rw_sweep_depth);
+        apr_array_clear(rw_sweep_reads);
+    }
+    for(j=0; j < rw_sweep_reads->nelts; ++j) {
+        int read_percent = APR_ARRAY_IDX(rw_sweep_reads, j, int);
+        mixed_profile = apr_pcalloc(pool, sizeof(struct mixed_profile));
+        mixed_profile->name = apr_psprintf(pool, "R/W mix %d%% read", read_percent);
+        mixed_profile->read_fraction = read_percent / 100.0;
+        mixed_profile->random_sizes.count = 1;
+        mixed_profile->random_sizes.sizes[0] = rw_sweep_size;
+        mixed_profile->random_sizes.weights[0] = 1.0;
+        mixed_profile->sequential_sizes = mixed_profile->random_sizes;
+        rv = mixed_request_generator_factory(&workload, mixed_profile);
+        assert(rv == APR_SUCCESS);
+        for(i=0; i < test_worker_count; ++i) {
+            prepare_workload(test_workers[i], workload, requestsize_array_rw_sweep, depth_array_rw_sweep);
+        }
+        first_statistics = options.statistics_array->nelts;
+        run_tests(mixed_profile->name, &options, test_workers, test_worker_count,
+                   0,
+                   0,
+                   NULL,
+                   0, NULL);
+        for(i=first_statistics; i < options.statistics_array->nelts; ++i) {
+            APR_ARRAY_PUSH(rw_sweep_statistics, struct io_statistics*) = APR_ARRAY_IDX(options.statistics_array, i, struct io_statistics*);
+        }
+    }
+
+    /* Write-ahead log, commits issued by ioworker */
+    if(wal_mode != 0) {
+        uint32_t wal_depth = wal_commit_writes > 0 ? wal_commit_writes : 1;
+        uint64_t wal_max_size = max_request_at_depth(test_workers, test_worker_count, wal_depth);
+        apr_array_header_t *wal_sizes = requestsize_array_wal;
+        if(wal_sizes->nelts == 0)
+            APR_ARRAY_PUSH(wal_sizes, uint64_t) = 4096;
+        requestsize_array_wal = apr_array_make(pool, wal_sizes->nelts, sizeof(uint64_t));
+        for(j=0; j < wal_sizes->nelts; ++j) {
+            uint64_t wal_size = APR_ARRAY_IDX(wal_sizes, j, uint64_t);
+            if(wal_size > wal_max_size) {
+                printf("WAL: %s writes at depth %u do not fit in the IO buffer, skipped\n",
+                       print_size(pool, "%.0f%cB", wal_size, K), wal_depth);
+                continue;
+            }
+            APR_ARRAY_PUSH(requestsize_array_wal, uint64_t) = wal_size;
+        }
+        APR_ARRAY_PUSH(depth_array_wal, uint32_t) = wal_depth;
+        if(requestsize_array_wal->nelts > 0) {
+            rv = wal_request_generator_factory(&workload, wal_mode, wal_commit_writes);
+            assert(rv == APR_SUCCESS);
+            for(i=0; i < test_worker_count; ++i) {
+                prepare_workload(test_workers[i], workload, requestsize_array_wal, depth_array_wal);
+            }
+            options.commit_writes = wal_commit_writes;
+            options.commit_interval = wal_commit_interval;
+            run_tests(wal_mode == WAL_APPEND ? "WAL append" : "WAL overwrite", &options, test_workers, test_worker_count,
+                       0,
+                       0,
+                       NULL,
+                       0, NULL);
+            options.commit_writes = 0;
+            options.commit_interval = 0;
+        }
+    }
+
+    if(trace_filename != NULL) {
+        rv = trace_request_generator_factory(&workload, trace_filename, trace_timed, pool);
+        if(rv != APR_SUCCESS) {
+            printf("Could not read trace %s\n", trace_filename);
+            return 1;
+        }
+        /* larger trace requests are truncated to the IO buffer */
+        uint64_t reqsize_trace = workload->max_io_size(workload);
+        if(reqsize_trace > test_workers[0]->bufsize)
+            reqsize_trace = test_workers[0]->bufsize;
+        APR_ARRAY_PUSH(requestsize_array_trace, uint64_t) = reqsize_trace;
+        for(i=0; i < test_worker_count; ++i) {
+            prepare_workload(test_workers[i], workload, requestsize_array_trace, queue_depth_array);
+        }
+        run_tests(trace_timed ? "Trace replay (timed)" : "Trace replay", &options, test_workers, test_worker_count,
+                   0,
+                   auto_terminate_depth,
+                   NULL,
+                   0, NULL);
+    }
+
+    /* Last, discarded ranges read back as zeroes */
+    if(discard_percents->nelts > 0 &&
+       discard_write_size > max_request_at_depth(test_workers, test_worker_count, APR_ARRAY_IDX(queue_depth_array, 0, uint32_t))) {
+        printf("Discard: %s writes at depth %u do not fit in the IO buffer, skipped\n",
+               print_size(pool, "%.0f%cB", discard_write_size, K), APR_ARRAY_IDX(queue_depth_array, 0, uint32_t));
+        apr_array_clear(discard_percents);
+    }
+    if(discard_percents->nelts > 0)
+        APR_ARRAY_PUSH(requestsize_array_discard, uint64_t) = discard_write_size;
+    for(j=0; j < discard_percents->nelts; ++j) {
+        int discard_percent = APR_ARRAY_IDX(discard_percents, j, int);
+        rv = discard_request_generator_factory(&workload, discard_percent / 100.0, discard_granularity);
+        assert(rv == APR_SUCCESS);
+        for(i=0; i < test_worker_count; ++i) {
+            prepare_workload(test_workers[i], workload, requestsize_array_discard, queue_depth_array);
+        }
+        run_tests(apr_psprintf(pool, "Write, %d%% discarded", discard_percent), &options, test_workers, test_worker_count,
+                   0,
+                   auto_terminate_depth,
+                   NULL,
+                   0, NULL);
     }
-    run_tests("Totaliaris mix", &options, workers, worker_array->nelts,
-               auto_terminate_request,
-               auto_terminate_depth,
-               NULL,
-               0, NULL);
 
     options.xml_output = print_xml_tag_close(pool, options.xml_output, "tests");
     apr_time_t end_time = apr_time_now();
@@ -1140,35 +2700,121 @@ int main(int argc, const char * const * argv)
             max_active = statistics->max_active;
         overall_score = statistics->accumulated_weighted_bytes_per_second/statistics->accumulated_weight;
     }
-    char *depths = print_array_depths(pool, max_active/worker_array->nelts, queue_depth_array);
+    char *depths = print_array_depths(pool, max_active/test_worker_count, queue_depth_array);
 
     printf("%-26s %s\n", "Configuration description:", machineId);
+    printf("%-26s %s\n", "IO engine:", options.platform_ops->name);
+    printf("%-26s %d\n", "Polled completions:", options.polled);
+    printf("%-26s %s\n", "Buffered IO:", options.buffered ? (options.cold_cache ? "cold cache" : "warm cache") : "off");
     printf("%-26s %s\n", "Preparation time:", print_time(pool, options.max_preparation_time));
     printf("%-26s %s\n", "Time per test:", print_time(pool, options.max_execution_time));
     printf("%-26s %d\n", "Random writing: ", options.write_random);
+    printf("%-26s %s\n", "Pattern kernel:", data_pattern_kernel());
+    char *verification = verify_threads > 0 ? apr_psprintf(pool, "%d threads", verify_threads) : "inline";
+    printf("%-26s %s\n", "Read verification:", verification);
+    char *pattern_pool = options.pattern_pool_size > 0 ? apr_pstrcat(pool, print_size(pool, "%.0f%cB", options.pattern_pool_size, K), " per worker", NULL) : "off";
+    printf("%-26s %s\n", "Pattern pool:", pattern_pool);
     printf("%-26s %s\n", "Iobuffer size: ", print_size(pool, "%.0f%cB", iobufsize, K));
     printf("%-26s %s\n", "Iosize(s) sequential:", sequential_requestsizes);
     printf("%-26s %s\n", "Iosize(s) random:", random_requestsizes);
     printf("%-26s %s\n", "Queue depths (per worker):", depths);
+    printf("%-26s %d (%s)\n", "Threads per file:", threads_per_file, shared_range ? "shared" : "partitioned");
+    printf("%-26s %s\n", "NUMA placement:", numa_modes[options.numa_mode]);
+    printf("%-26s %s\n", "IO buffer mode:", print_buffer_flags(pool, options.buffer_flags));
+    char *mixed_names = "";
+    for(j=0; j < mixed_profiles->nelts; ++j) {
+        mixed_profile = APR_ARRAY_IDX(mixed_profiles, j, struct mixed_profile*);
+        mixed_names = apr_psprintf(pool, "%s%s%s (%.0f%% read)", mixed_names, j > 0 ? ", " : "",
+                                   mixed_profile->name, mixed_profile->read_fraction*100.0);
+    }
+    printf("%-26s %s\n", "Mixed workloads:", mixed_names);
+    printf("%-26s %s\n", "Segments per request:", print_array_ints(pool, options.io_segments_array, "1"));
+    printf("%-26s %s\n", "Pinned cpus:", print_array_ints(pool, cpu_array, "none"));
+    char *offered_load = "closed loop";
+    for(j=0; j < options.rate_array->nelts; ++j) {
+        offered_load = apr_psprintf(pool, "%s%.0f", j > 0 ? apr_pstrcat(pool, offered_load, ",", NULL) : "",
+                                    APR_ARRAY_IDX(options.rate_array, j, double));
+    }
+    if(options.rate_array->nelts > 0) {
+        offered_load = apr_pstrcat(pool, offered_load, " IOPS, ",
+                                   options.arrival == ARRIVAL_POISSON ? "poisson" : "fixed", " arrivals", NULL);
+    }
+    printf("%-26s %s\n", "Offered load:", offered_load);
+    char *stream_setup = print_array_ints(pool, stream_counts, "off");
+    if(stream_counts->nelts > 0) {
+        stream_setup = apr_pstrcat(pool, stream_setup,
+                                   stream_layout == STREAMS_INTERLEAVED ? " interleaved, " : " regions, ",
+                                   stream_order == STREAMS_RANDOM ? "random" : "round-robin", NULL);
+    }
+    printf("%-26s %s\n", "Sequential streams:", stream_setup);
+    char *alignments = "request size";
+    for(j=0; j < alignment_array->nelts; ++j) {
+        alignments = apr_pstrcat(pool, alignments, j > 0 ? "," : ", ",
+                                 print_size(pool, "%.0f%cB", APR_ARRAY_IDX(alignment_array, j, uint64_t), K), NULL);
+    }
+    printf("%-26s %s\n", "Random alignment:", alignments);
+    char *working_set_sizes = "whole file";
+    for(j=0; j < working_sets->nelts; ++j) {
+        working_set_sizes = apr_pstrcat(pool, j > 0 ? working_set_sizes : "", j > 0 ? "," : "",
+                                        print_size(pool, "%.0f%cB", APR_ARRAY_IDX(working_sets, j, uint64_t), K), NULL);
+    }
+    printf("%-26s %s\n", "Random working set:", working_set_sizes);
+    char *wal_setup = "off";
+    if(wal_mode != 0) {
+        wal_setup = apr_psprintf(pool, "%s, %s writes, fdatasync every %s",
+                                 wal_mode == WAL_APPEND ? "append" : "overwrite",
+                                 print_array_size(pool, UINT64_MAX, requestsize_array_wal),
+                                 wal_commit_writes > 0 ? apr_psprintf(pool, "%d writes", wal_commit_writes) : print_time(pool, wal_commit_interval));
+    }
+    printf("%-26s %s\n", "Write-ahead log:", wal_setup);
+    char *discard_setup = print_array_ints(pool, discard_percents, "off");
+    if(discard_percents->nelts > 0) {
+        discard_setup = apr_psprintf(pool, "%s%% of %s regions, %s writes", discard_setup,
+                                     print_size(pool, "%.0f%cB", discard_granularity, K),
+                                     print_size(pool, "%.0f%cB", discard_write_size, K));
+    }
+    printf("%-26s %s\n", "Discard:", discard_setup);
 
     options.xml_output = print_xml_tag_str(pool,options.xml_output, "configuration_description", machineId);
+    options.xml_output = print_xml_tag_str(pool,options.xml_output, "io_engine", (char *) options.platform_ops->name);
+    options.xml_output = print_xml_tag_number(pool,options.xml_output, "polled", options.polled);
+    options.xml_output = print_xml_tag_str(pool,options.xml_output, "buffered_io", options.buffered ? (options.cold_cache ? "cold" : "warm") : "off");
     options.xml_output = print_xml_tag_time(pool,options.xml_output, "preparation_time", options.max_preparation_time);
     options.xml_output = print_xml_tag_time(pool,options.xml_output, "time_per_test", options.max_execution_time);
     options.xml_output = print_xml_tag_number(pool,options.xml_output, "random_writing", options.write_random);
+    options.xml_output = print_xml_tag_str(pool,options.xml_output, "pattern_kernel", (char *) data_pattern_kernel());
+    options.xml_output = print_xml_tag_str(pool,options.xml_output, "read_verification", verification);
+    options.xml_output = print_xml_tag_str(pool,options.xml_output, "pattern_pool", pattern_pool);
     options.xml_output = print_xml_tag_size(pool,options.xml_output, "iobuffer_size", BYTES_FMT, iobufsize);
     options.xml_output = print_xml_tag_str(pool,options.xml_output, "iosizes_sequential", sequential_requestsizes);
     options.xml_output = print_xml_tag_str(pool,options.xml_output, "iosizes_random", random_requestsizes);
     options.xml_output = print_xml_tag_str(pool,options.xml_output, "queue_depths", depths);
+    options.xml_output = print_xml_tag_number(pool,options.xml_output, "threads_per_file", threads_per_file);
+    options.xml_output = print_xml_tag_str(pool,options.xml_output, "thread_range", shared_range ? "shared" : "partitioned");
+    options.xml_output = print_xml_tag_str(pool,options.xml_output, "numa_placement", (char *) numa_modes[options.numa_mode]);
+    options.xml_output = print_xml_tag_str(pool,options.xml_output, "buffer_mode", print_buffer_flags(pool, options.buffer_flags));
+    options.xml_output = print_xml_tag_str(pool,options.xml_output, "mixed_workloads", mixed_names);
+    options.xml_output = print_xml_tag_str(pool,options.xml_output, "segments_per_request", print_array_ints(pool, options.io_segments_array, "1"));
+    options.xml_output = print_xml_tag_str(pool,options.xml_output, "pinned_cpus", print_array_ints(pool, cpu_array, "none"));
+    options.xml_output = print_xml_tag_str(pool,options.xml_output, "offered_load", offered_load);
+    options.xml_output = print_xml_tag_str(pool,options.xml_output, "sequential_streams", stream_setup);
+    options.xml_output = print_xml_tag_str(pool,options.xml_output, "random_alignment", alignments);
+    options.xml_output = print_xml_tag_str(pool,options.xml_output, "random_working_set", working_set_sizes);
+    options.xml_output = print_xml_tag_str(pool,options.xml_output, "write_ahead_log", wal_setup);
+    options.xml_output = print_xml_tag_str(pool,options.xml_output, "discard", discard_setup);
 
     options.xml_output = print_xml_tag_open(pool, options.xml_output, "workers");
     for(i=0; i < worker_array->nelts; ++i) {
         options.xml_output = print_xml_tag_open(pool, options.xml_output, "worker");
         printf("%-26s %s\n",apr_psprintf(pool,"Worker %d:",i),
-            apr_psprintf(pool,"%s of size %s",workers[i]->filename,
-                print_size(pool, "%.0f%cB", workers[i]->filesize, K)));
+            apr_psprintf(pool,"%s of size %s, device node %d, %s buffer",workers[i]->filename,
+                print_size(pool, "%.0f%cB", workers[i]->filesize, K), workers[i]->device_node,
+                print_buffer_flags(pool, workers[i]->buffer_flags)));
         options.xml_output = print_xml_tag_number(pool, options.xml_output, "id", i);
         options.xml_output = print_xml_tag_str(pool, options.xml_output, "filename", workers[i]->filename);
         options.xml_output = print_xml_tag_size(pool, options.xml_output, "size", BYTES_FMT, workers[i]->filesize);
+        options.xml_output = print_xml_tag_str(pool, options.xml_output, "device_node", apr_itoa(pool, workers[i]->device_node));
+        options.xml_output = print_xml_tag_str(pool, options.xml_output, "buffer_mode", print_buffer_flags(pool, workers[i]->buffer_flags));
         options.xml_output = print_xml_tag_close(pool, options.xml_output, "worker");
     }
     options.xml_output = print_xml_tag_close(pool, options.xml_output, "workers");
@@ -1218,9 +2864,58 @@ int main(int argc, const char * const * argv)
     options.xml_output = print_xml_tag_close(pool, options.xml_output, "test_summary");
 
     print_statistics_seperator(pool);
+
+    if(rw_sweep_statistics->nelts > 0) {
+        printf("\nRead/write mix, %s requests at depth %u:\n\n", print_size(pool, "%.0f%cB", rw_sweep_size, K), rw_sweep_depth);
+        printf("%-25s  %13s  %12s  %11s  %11s  %11s  %11s\n",
+               "", "", "", "Avg read","Max read","Avg write","Max write");
+        printf("%-25s  %13s  %12s  %11s  %11s  %11s  %11s\n",
+               "Workload", "IOPS", "Throughput", "Latency", "Latency", "Latency", "Latency");
+        print_statistics_seperator(pool);
+        options.xml_output = print_xml_tag_open(pool, options.xml_output, "rw_mix_curve");
+        for(i=0; i < rw_sweep_statistics->nelts; ++i) {
+            statistics = APR_ARRAY_IDX(rw_sweep_statistics, i, struct io_statistics*);
+            if(statistics->lines->nelts == 0)
+                continue;
+            struct io_statistics_line *mix_line = &APR_ARRAY_IDX(statistics->lines, statistics->lines->nelts-1, struct io_statistics_line);
+            double mix_iops = (((double) mix_line->total_requests)/(double) mix_line->total_elapsed)*apr_time_from_sec(1);
+            apr_time_t avg_read_latency = mix_line->read_requests > 0 ? mix_line->read_elapsed / mix_line->read_requests : 0;
+            apr_time_t avg_write_latency = mix_line->write_requests > 0 ? mix_line->write_elapsed / mix_line->write_requests : 0;
+            printf("%-25s  %13s  %12s  %11s  %11s  %11s  %11s\n",
+            statistics->description,
+            print_size(pool, IOPS_FMT, mix_iops, K),
+            print_size(pool, THROUGHPUT_FMT, mix_line->bytes_per_second, K),
+            mix_line->read_requests > 0 ? print_time(pool, avg_read_latency) : "-",
+            mix_line->read_requests > 0 ? print_time(pool, mix_line->max_read_latency) : "-",
+            mix_line->write_requests > 0 ? print_time(pool, avg_write_latency) : "-",
+            mix_line->write_requests > 0 ? print_time(pool, mix_line->max_write_latency) : "-");
+            options.xml_output = print_xml_tag_open(pool, options.xml_output, "point");
+            options.xml_output = print_xml_tag_str(pool, options.xml_output, "description", statistics->description);
+            options.xml_output = print_xml_tag_size(pool, options.xml_output, "iops", IOPS_FMT, mix_iops);
+            options.xml_output = print_xml_tag_size(pool, options.xml_output, "bytes_per_second", THROUGHPUT_FMT, mix_line->bytes_per_second);
+            options.xml_output = print_xml_tag_size(pool, options.xml_output, "read_requests", REQUEST_FMT, mix_line->read_requests);
+            options.xml_output = print_xml_tag_size(pool, options.xml_output, "write_requests", REQUEST_FMT, mix_line->write_requests);
+            options.xml_output = print_xml_tag_time(pool, options.xml_output, "avg_read_latency", avg_read_latency);
+            options.xml_output = print_xml_tag_time(pool, options.xml_output, "max_read_latency", mix_line->max_read_latency);
+            options.xml_output = print_xml_tag_time(pool, options.xml_output, "avg_write_latency", avg_write_latency);
+            options.xml_output = print_xml_tag_time(pool, options.xml_output, "max_write_latency", mix_line->max_write_latency);
+            options.xml_output = print_xml_tag_close(pool, options.xml_output, "point");
+        }
+        options.xml_output = print_xml_tag_close(pool, options.xml_output, "rw_mix_curve");
+        print_statistics_seperator(pool);
+    }
 	printf("\nCleaning up\n");
+	if(test_workers != workers) {
+	    rv = destroy_workers(test_workers, test_worker_count, pool);
+	    assert(rv == APR_SUCCESS);
+	    free(test_workers);
+	}
 	rv = destroy_workers(workers, worker_array->nelts, pool);
 	assert(rv == APR_SUCCESS);
+	if(options.verify_pool != NULL) {
+	    rv = verify_pool_destroy(options.verify_pool);
+	    assert(rv == APR_SUCCESS);
+	}
 
     options.xml_output = print_xml_tag_size(pool, options.xml_output, "bytes_written", BYTES_FMT, bytes_written);
     options.xml_output = print_xml_tag_size(pool, options.xml_output, "bytes_read", BYTES_FMT, bytes_read);
@@ -21,6 +21,12 @@
 
 #include "diskBench.h"
 
+/*
+ * Mixed random/sequential read/write workload. The mix is described by a
+ * struct mixed_profile; the default is the Totaliaris mix. Request sizes are
+ * drawn from per-class alias tables (Vose) in constant time.
+ */
+
 static uint32_t blocksizes[13] = {
         512,
         1024,
@@ -37,13 +43,27 @@ static uint32_t blocksizes[13] = {
         2048*1024
 };
 
+/* Keep threshold for alias tables, probabilities are scaled to 2^32 */
+#define ALIAS_ONE (UINT64_C(1) << 32)
+
+struct alias_table {
+    int count;
+    uint64_t sizes[MIXED_MAX_SIZES];
+    uint64_t prob[MIXED_MAX_SIZES];
+    int alias[MIXED_MAX_SIZES];
+};
+
  struct mixed_request_generator_data {
+    struct mixed_profile profile;
 
-    uint32_t sequential_blocksize_prob[13];
-    uint32_t random_blocksize_prob[13];
+    /* thresholds on 32 random bits */
+    uint64_t read_threshold;
+    uint64_t sequential_read_threshold;
+    uint64_t sequential_write_threshold;
 
-    int min_blocksize_idx;
-    int blocksizes;
+    struct alias_table random_sizes;
+    struct alias_table sequential_sizes;
+    uint64_t max_size;
 
     /* seq write forward */
     uint64_t seq_pos1;
@@ -55,34 +75,107 @@ static uint32_t blocksizes[13] = {
     uint64_t seq_pos4;
 };
 
-static uint32_t get_random_iosize(struct mixed_request_generator_data *data, uint32_t random_low)
+/* Vose's alias method */
+static void build_alias_table(struct alias_table *table, const struct mixed_size_distribution *distribution)
 {
-    int start = data->min_blocksize_idx;
-    int end = start + data->blocksizes - 1;
-    int i;
-    uint32_t cmp;
-    for(i=start; i < end; ++i)
-    {
-        cmp = data->random_blocksize_prob[i];
-        if(random_low < cmp)
-            return blocksizes[i];
+    double scaled[MIXED_MAX_SIZES];
+    int small[MIXED_MAX_SIZES];
+    int large[MIXED_MAX_SIZES];
+    int nsmall = 0, nlarge = 0;
+    double total = 0.0;
+    int i, s, l;
+
+    table->count = distribution->count;
+    for(i=0; i < distribution->count; ++i) {
+        total += distribution->weights[i];
+    }
+    for(i=0; i < distribution->count; ++i) {
+        table->sizes[i] = distribution->sizes[i];
+        table->alias[i] = i;
+        scaled[i] = distribution->weights[i] * distribution->count / total;
+        if(scaled[i] < 1.0) {
+            small[nsmall++] = i;
+        } else {
+            large[nlarge++] = i;
+        }
+    }
+    while(nsmall > 0 && nlarge > 0) {
+        s = small[--nsmall];
+        l = large[--nlarge];
+        table->prob[s] = (uint64_t) (scaled[s] * ALIAS_ONE);
+        table->alias[s] = l;
+        scaled[l] = scaled[l] + scaled[s] - 1.0;
+        if(scaled[l] < 1.0) {
+            small[nsmall++] = l;
+        } else {
+            large[nlarge++] = l;
+        }
+    }
+    /* left overs are 1 up to rounding */
+    while(nlarge > 0) {
+        table->prob[large[--nlarge]] = ALIAS_ONE;
+    }
+    while(nsmall > 0) {
+        table->prob[small[--nsmall]] = ALIAS_ONE;
     }
-    return blocksizes[end];
 }
 
-static uint32_t get_sequential_iosize(struct mixed_request_generator_data *data, uint32_t random_low)
+static uint64_t sample_alias_table(struct alias_table *table, uint64_t random)
 {
-    int start = data->min_blocksize_idx;
-    int end = start + data->blocksizes - 1;
+    int i = (int) (((random & UINT32_MAX) * table->count) >> 32);
+
+    if((random >> 32) < table->prob[i])
+        return table->sizes[i];
+    return table->sizes[table->alias[i]];
+}
+
+/*
+ * Sizes from reqsize up, centred at base. Request bandwidth halves on either side.
+ */
+static void default_distribution(struct mixed_size_distribution *distribution, uint64_t reqsize, uint64_t base)
+{
+    double factor;
     int i;
-    uint32_t cmp;
-    for(i=start; i < end; ++i)
-    {
-        cmp = data->sequential_blocksize_prob[i];
-        if(random_low < cmp)
-            return blocksizes[i];
+
+    distribution->count = 0;
+    for(i=0; i < 13; ++i) {
+        if(blocksizes[i] < reqsize)
+            continue;
+        if(blocksizes[i] < base) {
+            factor = (double) base/blocksizes[i];
+        } else {
+            factor = (double) blocksizes[i]/base;
+        }
+        distribution->sizes[distribution->count] = blocksizes[i];
+        distribution->weights[distribution->count] = 1.0/(factor*factor);
+        distribution->count = distribution->count + 1;
+    }
+    if(distribution->count == 0) {
+        distribution->sizes[0] = reqsize;
+        distribution->weights[0] = 1.0;
+        distribution->count = 1;
+    }
+}
+
+static void sequential_request(struct io_workload_generator *workload_generator, struct io_request *request,
+                               uint64_t iosize, int forward, uint64_t *forward_pos, uint64_t *backward_pos)
+{
+    uint64_t filesize = workload_generator->workload->worker->filesize;
+
+    request->size = iosize;
+    if(forward) {
+        if(*forward_pos + iosize > filesize)
+            *forward_pos = 0;
+
+        request->offset = *forward_pos;
+        *forward_pos += iosize;
+    } else {
+        if(*backward_pos < iosize)
+            *backward_pos = filesize - filesize % iosize;
+
+        *backward_pos -= iosize;
+        request->offset = *backward_pos;
     }
-    return blocksizes[end];
 }
 
 static apr_status_t mixed_request_generator_fill_request(
@@ -94,62 +187,33 @@ static apr_status_t mixed_request_generator_fill_request(
     uint64_t *random_seed = &workload_generator->workload->worker->random_seed;
 
 	uint64_t random_base = random_uint64_t(random_seed);
-	uint32_t random_low = random_base&UINT32_MAX;
-	uint32_t iosize;
+	uint64_t random_size = random_uint64_t(random_seed);
+	uint64_t random_low = random_base & UINT32_MAX;
+	uint64_t random_high = random_base >> 32;
+	uint64_t iosize;
 
-	if(random_low < 0.75*UINT32_MAX) {
+	if(random_low < data->read_threshold) {
 	    request->write = 0;
-        if((random_low & 0x1F) == 0) {
+        if(random_high < data->sequential_read_threshold) {
             /* sequential read */
-            iosize = get_sequential_iosize(data, random_base>>32);
-            request->size = iosize;
-            if(random_low & 1) {
-                /* forward */
-                if(data->seq_pos1 + iosize > workload_generator->workload->worker->filesize)
-                    data->seq_pos1 = 0;
-
-                request->offset = data->seq_pos1;
-                data->seq_pos1 += iosize;
-            } else {
-                /* backward */
-                if(data->seq_pos2 < iosize)
-                    data->seq_pos2 = workload_generator->workload->worker->filesize;
-
-                data->seq_pos2 -= iosize;
-                request->offset = data->seq_pos2;
-            }
+            iosize = sample_alias_table(&data->sequential_sizes, random_size);
+            sequential_request(workload_generator, request, iosize, random_low & 1, &data->seq_pos1, &data->seq_pos2);
         } else {
             /* random read */
-            iosize = get_random_iosize(data, random_base>>32);
+            iosize = sample_alias_table(&data->random_sizes, random_size);
             request->offset = random_base % (workload_generator->workload->worker->filesize / iosize);
             request->offset = request->offset  * iosize;
             request->size = iosize;
         }
 	} else {
         request->write = 1;
-        if((random_low & 0x1F) <= 1) {
-
+        if(random_high < data->sequential_write_threshold) {
             /* sequential write.  */
-            iosize = get_sequential_iosize(data, random_base>>32);
-            request->size = iosize;
-            if(random_low & 1) {
-                /* forward */
-                if(data->seq_pos3 + iosize > workload_generator->workload->worker->filesize)
-                    data->seq_pos3 = 0;
-
-                request->offset = data->seq_pos3;
-                data->seq_pos3 += iosize;
-            } else {
-                /* backward */
-                if(data->seq_pos4 < iosize)
-                    data->seq_pos4 = workload_generator->workload->worker->filesize;
-
-                data->seq_pos4 -= iosize;
-                request->offset = data->seq_pos4;
-            }
+            iosize = sample_alias_table(&data->sequential_sizes, random_size);
+            sequential_request(workload_generator, request, iosize, random_low & 1, &data->seq_pos3, &data->seq_pos4);
         } else {
             /* random write */
-            iosize = get_random_iosize(data, random_base>>32);
+            iosize = sample_alias_table(&data->random_sizes, random_size);
             request->offset = random_base % (workload_generator->workload->worker->filesize / iosize);
             request->offset = request->offset  * iosize;
             request->size = iosize;
@@ -163,7 +227,7 @@ static uint64_t mixed_request_generator_max_iosize(struct io_workload_generator
 {
     struct mixed_request_generator_data *data = (struct mixed_request_generator_data*) workload_generator->generator_data;
 
-    return UINT64_C(2*1024*1024);
+    return data->max_size;
 }
 
 static uint64_t mixed_request_generator_weighted_iosize(struct io_workload_generator *workload_generator)
@@ -174,19 +238,10 @@ static uint64_t mixed_request_generator_weighted_iosize(struct io_workload_gener
 
 static apr_status_t mixed_request_generator_reset(struct io_workload_generator *template_generator, struct io_workload *workload, uint64_t reqsize)
 {
-    int i=0;
-    double random_factors[13];
-    double sequential_factors[13];
-    double acc_random_factors = 0.0;
-    double acc_sequential_factors = 0.0;
-    double current_random_factor;
-    double current_sequential_factor;
-    uint32_t sequential_value;
-    uint32_t random_value;
-    double base_random_value;
-    double base_sequential_value;
-
+    struct mixed_size_distribution distribution;
     struct mixed_request_generator_data *data;
+    int i;
+
     if(workload->request_generator != NULL) {
         if(workload->request_generator->generator_data != NULL) {
             free(workload->request_generator->generator_data);
@@ -205,61 +260,61 @@ static apr_status_t mixed_request_generator_reset(struct io_workload_generator *
     data->seq_pos2 = 0;
     data->seq_pos3 = 0;
     data->seq_pos4 = 0;
-    data->min_blocksize_idx = 0;
-    while(blocksizes[data->min_blocksize_idx] < reqsize) {
-        data->min_blocksize_idx = data->min_blocksize_idx + 1;
-    }
-    data->blocksizes = 13 - data->min_blocksize_idx;
-
-    /**
-     * Calculate request size probability:
-     *      Random requests. Base reqsize is 4k. Request bandwidth halves on either side.
-     *      Sequential requests. Base reqsize is 128k. Request bandwith halves on either side.
-     *
-     */
-    for(i=data->min_blocksize_idx; i < data->min_blocksize_idx + data->blocksizes; ++i) {
-
-        if(blocksizes[i] < 4096) {
-            current_random_factor = (double) 4096/blocksizes[i];
-        } else {
-            current_random_factor = (double) blocksizes[i]/4096;
-        }
-        current_random_factor = current_random_factor * current_random_factor;
-        current_random_factor = 1.0/current_random_factor;
 
-        if(blocksizes[i] < 128*1024) {
-            current_sequential_factor = (double) 128*1024/blocksizes[i];
-        } else {
-            current_sequential_factor = (double) blocksizes[i]/(128*1024);
-        }
-        current_sequential_factor = current_sequential_factor  * current_sequential_factor;
-        current_sequential_factor = 1.0/current_sequential_factor;
+    data->read_threshold = (uint64_t) (data->profile.read_fraction * ALIAS_ONE);
+    data->sequential_read_threshold = (uint64_t) (data->profile.sequential_read_fraction * ALIAS_ONE);
+    data->sequential_write_threshold = (uint64_t) (data->profile.sequential_write_fraction * ALIAS_ONE);
 
-        if(i>data->min_blocksize_idx) {
-            current_random_factor += random_factors[i-1];
-            current_sequential_factor += sequential_factors[i-1];
-        }
-        random_factors[i] = current_random_factor;
-        sequential_factors[i] = current_sequential_factor;
+    /* Sizes not given by the profile: random centred at 4k, sequential at 128k */
+    if(data->profile.random_sizes.count > 0) {
+        build_alias_table(&data->random_sizes, &data->profile.random_sizes);
+    } else {
+        default_distribution(&distribution, reqsize, 4096);
+        build_alias_table(&data->random_sizes, &distribution);
+    }
+    if(data->profile.sequential_sizes.count > 0) {
+        build_alias_table(&data->sequential_sizes, &data->profile.sequential_sizes);
+    } else {
+        default_distribution(&distribution, reqsize, 128*1024);
+        build_alias_table(&data->sequential_sizes, &distribution);
     }
 
-    for(i=data->min_blocksize_idx; i < data->min_blocksize_idx + data->blocksizes; ++i) {
-        random_factors[i] = random_factors[i]/current_random_factor;
-        sequential_factors[i] = sequential_factors[i]/current_sequential_factor;
-
-        data->random_blocksize_prob[i] = UINT32_MAX*random_factors[i];
-        data->sequential_blocksize_prob[i] = UINT32_MAX*sequential_factors[i];
+    data->max_size = 0;
+    for(i=0; i < data->random_sizes.count; ++i) {
+        if(data->random_sizes.sizes[i] > data->max_size)
+            data->max_size = data->random_sizes.sizes[i];
+    }
+    for(i=0; i < data->sequential_sizes.count; ++i) {
+        if(data->sequential_sizes.sizes[i] > data->max_size)
+            data->max_size = data->sequential_sizes.sizes[i];
     }
 
     return APR_SUCCESS;
 }
 
+void mixed_profile_default(struct mixed_profile *profile)
+{
+    memset(profile, 0, sizeof(struct mixed_profile));
+    profile->name = "Totaliaris mix";
+    /* 75% reads, 1 in 32 reads and 2 in 32 writes sequential */
+    profile->read_fraction = 0.75;
+    profile->sequential_read_fraction = 1.0/32;
+    profile->sequential_write_fraction = 2.0/32;
+}
+
 apr_status_t mixed_request_generator_factory(
     struct io_workload_generator **request_generator,
-    int write
+    const struct mixed_profile *profile
 )
 {
     struct mixed_request_generator_data *data = calloc(1, sizeof(struct mixed_request_generator_data));
+    if(profile != NULL) {
+        memcpy(&data->profile, profile, sizeof(struct mixed_profile));
+    } else {
+        mixed_profile_default(&data->profile);
+    }
+    /* for max_io_size before the first reset */
+    data->max_size = UINT64_C(2*1024*1024);
     *request_generator = malloc(sizeof(struct io_workload_generator));
     (*request_generator)->generator_data = data;
     (*request_generator)->fill_request = &mixed_request_generator_fill_request;
@@ -269,5 +324,3 @@ apr_status_t mixed_request_generator_factory(
 
     return APR_SUCCESS;
 }
-
-
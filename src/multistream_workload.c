@@ -0,0 +1,156 @@
+/*
+  * multistream_workload.c
+  *
+  * Part of diskBench - IO bandwidth measurement
+  *
+  * Copyright (C) 2010-2011  Amund Elstad <amund.elstad@gmail.com>
+  *
+  *  This program is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *   the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  This program is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *   GNU General Public License for more details.
+  *
+  *   You should have received a copy of the GNU General Public License
+  *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+#include "diskBench.h"
+
+/*
+ * Several independent sequential streams per worker, like concurrent append
+ * logs. With STREAMS_REGION every stream walks its own slice of the file,
+ * with STREAMS_INTERLEAVED stream s owns every streams'th request-sized
+ * block starting at block s. Each request continues the stream picked
+ * round-robin or at random.
+ */
+
+ struct multistream_request_generator_data {
+    int write;
+    int streams;
+    int layout;
+    int order;
+    uint64_t req_size;
+
+    /* blocks of req_size per stream */
+    uint64_t stream_blocks;
+    int next_stream;
+    /* next block within each stream */
+    uint64_t positions[MAX_STREAMS];
+};
+
+static apr_status_t multistream_request_generator_fill_request(
+    struct io_workload_generator *workload_generator,
+    struct io_request *request
+)
+{
+    struct multistream_request_generator_data *data = (struct multistream_request_generator_data*) workload_generator->generator_data;
+    uint64_t block;
+    int stream;
+
+    if(data->order == STREAMS_RANDOM) {
+        stream = (int) (random_uint64_t(&workload_generator->workload->worker->random_seed) % data->streams);
+    } else {
+        stream = data->next_stream;
+        data->next_stream = (data->next_stream + 1) % data->streams;
+    }
+
+    block = data->positions[stream];
+    data->positions[stream] = (block + 1) % data->stream_blocks;
+
+    if(data->layout == STREAMS_INTERLEAVED) {
+        block = block * data->streams + stream;
+    } else {
+        block = stream * data->stream_blocks + block;
+    }
+
+    request->offset = block * data->req_size;
+    request->size = data->req_size;
+    request->write = data->write;
+
+    return APR_SUCCESS;
+}
+
+static uint64_t multistream_request_generator_max_iosize(struct io_workload_generator *workload_generator)
+{
+    struct multistream_request_generator_data *data = (struct multistream_request_generator_data*) workload_generator->generator_data;
+
+    return data->req_size;
+}
+
+static uint64_t multistream_request_generator_weighted_iosize(struct io_workload_generator *workload_generator)
+{
+    return UINT64_C(128*1024);
+}
+
+
+static apr_status_t multistream_request_generator_reset(struct io_workload_generator *template_generator, struct io_workload *workload, uint64_t reqsize)
+{
+    struct multistream_request_generator_data *data;
+    uint64_t blocks;
+    int i;
+
+    if(workload->request_generator != NULL) {
+        if(workload->request_generator->generator_data != NULL) {
+            free(workload->request_generator->generator_data);
+        }
+        free(workload->request_generator);
+        workload->request_generator = NULL;
+    }
+    ((struct multistream_request_generator_data*) template_generator->generator_data)->req_size = reqsize;
+
+    workload->request_generator = malloc(sizeof(struct io_workload_generator));
+    memcpy(workload->request_generator, template_generator, sizeof(struct io_workload_generator));
+    data = malloc(sizeof(struct multistream_request_generator_data));
+    memcpy(data, template_generator->generator_data, sizeof(struct multistream_request_generator_data));
+
+    /* every stream needs at least one block of the worker's range */
+    blocks = workload->worker->filesize / reqsize;
+    if(blocks == 0)
+        blocks = 1;
+    if((uint64_t) data->streams > blocks) {
+        printf("%d streams of %"APR_UINT64_T_FMT" bytes do not fit in %s, using %"APR_UINT64_T_FMT" streams\n",
+               data->streams, (apr_uint64_t) reqsize, workload->worker->filename, (apr_uint64_t) blocks);
+        data->streams = (int) blocks;
+    }
+    data->stream_blocks = blocks / data->streams;
+    data->next_stream = 0;
+    for(i=0; i < data->streams; ++i) {
+        data->positions[i] = 0;
+    }
+    workload->request_generator->generator_data = data;
+    workload->request_generator->workload = workload;
+
+    return APR_SUCCESS;
+}
+
+apr_status_t multistream_request_generator_factory(
+    struct io_workload_generator **request_generator,
+    int write,
+    int streams,
+    int layout,
+    int order
+)
+{
+    struct multistream_request_generator_data *data;
+
+    if(streams < 1 || streams > MAX_STREAMS)
+        return APR_EINVAL;
+
+    data = calloc(1, sizeof(struct multistream_request_generator_data));
+    *request_generator = malloc(sizeof(struct io_workload_generator));
+    data->write = write;
+    data->streams = streams;
+    data->layout = layout;
+    data->order = order;
+    (*request_generator)->generator_data = data;
+    (*request_generator)->fill_request = &multistream_request_generator_fill_request;
+    (*request_generator)->max_io_size = &multistream_request_generator_max_iosize;
+    (*request_generator)->weighted_io_size = &multistream_request_generator_weighted_iosize;
+    (*request_generator)->reset = &multistream_request_generator_reset;
+
+    return APR_SUCCESS;
+}
@@ -0,0 +1,164 @@
+/*
+  * pattern_workload.c
+  *
+  * Part of diskBench - IO bandwidth measurement
+  *
+  * Copyright (C) 2010-2011  Amund Elstad <amund.elstad@gmail.com>
+  *
+  *  This program is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *   the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  This program is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *   GNU General Public License for more details.
+  *
+  *   You should have received a copy of the GNU General Public License
+  *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+#include "diskBench.h"
+
+/*
+ * Deterministic non-sequential patterns:
+ *
+ *   PATTERN_STRIDED    skip gap bytes after every request. Each pass over the
+ *                      file starts one request further in, so repeated
+ *                      passes cover the gaps.
+ *   PATTERN_REVERSE    sequential from the end of the file towards the start.
+ *   PATTERN_BUTTERFLY  alternate between the start and the end of the file,
+ *                      both moving towards the middle.
+ */
+
+ struct pattern_request_generator_data {
+    int write;
+    int pattern;
+    uint64_t gap;
+    uint64_t req_size;
+
+    /* usable size, a multiple of req_size */
+    uint64_t size;
+    uint64_t low;
+    uint64_t high;
+    uint64_t phase;
+    int toggle;
+};
+
+static apr_status_t pattern_request_generator_fill_request(
+    struct io_workload_generator *workload_generator,
+    struct io_request *request
+)
+{
+    struct pattern_request_generator_data *data = (struct pattern_request_generator_data*) workload_generator->generator_data;
+
+    switch(data->pattern) {
+    case PATTERN_STRIDED:
+        if(data->low + data->req_size > data->size) {
+            data->phase = (data->phase + data->req_size) % (data->req_size + data->gap);
+            if(data->phase + data->req_size > data->size)
+                data->phase = 0;
+            data->low = data->phase;
+        }
+        request->offset = data->low;
+        data->low += data->req_size + data->gap;
+        break;
+    case PATTERN_REVERSE:
+        request->offset = data->high;
+        data->high = data->high >= data->req_size ? data->high - data->req_size : data->size - data->req_size;
+        break;
+    default:
+        if(data->low > data->high) {
+            data->low = 0;
+            data->high = data->size - data->req_size;
+        }
+        if(data->toggle) {
+            request->offset = data->high;
+            if(data->high < data->req_size) {
+                /* single block file */
+                data->low = data->req_size;
+            } else {
+                data->high -= data->req_size;
+            }
+        } else {
+            request->offset = data->low;
+            data->low += data->req_size;
+        }
+        data->toggle = !data->toggle;
+        break;
+    }
+    request->size = data->req_size;
+    request->write = data->write;
+
+    return APR_SUCCESS;
+}
+
+static uint64_t pattern_request_generator_max_iosize(struct io_workload_generator *workload_generator)
+{
+    struct pattern_request_generator_data *data = (struct pattern_request_generator_data*) workload_generator->generator_data;
+
+    return data->req_size;
+}
+
+static uint64_t pattern_request_generator_weighted_iosize(struct io_workload_generator *workload_generator)
+{
+    return UINT64_C(128*1024);
+}
+
+
+static apr_status_t pattern_request_generator_reset(struct io_workload_generator *template_generator, struct io_workload *workload, uint64_t reqsize)
+{
+    struct pattern_request_generator_data *data;
+
+    if(workload->request_generator != NULL) {
+        if(workload->request_generator->generator_data != NULL) {
+            free(workload->request_generator->generator_data);
+        }
+        free(workload->request_generator);
+        workload->request_generator = NULL;
+    }
+    ((struct pattern_request_generator_data*) template_generator->generator_data)->req_size = reqsize;
+
+    workload->request_generator = malloc(sizeof(struct io_workload_generator));
+    memcpy(workload->request_generator, template_generator, sizeof(struct io_workload_generator));
+    data = malloc(sizeof(struct pattern_request_generator_data));
+    memcpy(data, template_generator->generator_data, sizeof(struct pattern_request_generator_data));
+
+    data->size = workload->worker->filesize - workload->worker->filesize % reqsize;
+    if(data->size < reqsize)
+        data->size = reqsize;
+    data->low = 0;
+    data->high = data->size - reqsize;
+    data->phase = 0;
+    data->toggle = 0;
+    workload->request_generator->generator_data = data;
+    workload->request_generator->workload = workload;
+
+    return APR_SUCCESS;
+}
+
+apr_status_t pattern_request_generator_factory(
+    struct io_workload_generator **request_generator,
+    int write,
+    int pattern,
+    uint64_t gap
+)
+{
+    struct pattern_request_generator_data *data;
+
+    if(pattern != PATTERN_STRIDED && pattern != PATTERN_REVERSE && pattern != PATTERN_BUTTERFLY)
+        return APR_EINVAL;
+
+    data = calloc(1, sizeof(struct pattern_request_generator_data));
+    *request_generator = malloc(sizeof(struct io_workload_generator));
+    data->write = write;
+    data->pattern = pattern;
+    data->gap = gap;
+    (*request_generator)->generator_data = data;
+    (*request_generator)->fill_request = &pattern_request_generator_fill_request;
+    (*request_generator)->max_io_size = &pattern_request_generator_max_iosize;
+    (*request_generator)->weighted_io_size = &pattern_request_generator_weighted_iosize;
+    (*request_generator)->reset = &pattern_request_generator_reset;
+
+    return APR_SUCCESS;
+}
@@ -20,28 +20,33 @@
   */
 #include "diskBench.h"
 
-#define NONRANDOM_CONSTANT UINT64_C(0xABCDEF9876543210)
-
-static void integrity_error(struct io_request *request)
+void integrity_error(struct io_request *request)
 {
     printf("ERROR: Data integrity error at offset %"APR_UINT64_T_FMT ". Check your hardware/software!\n", (apr_uint64_t) request->offset);
     exit(1);
 }
 
+/*
+ * Scheduled requests count latency from the time they were due, so queueing
+ * behind a stalled device is not hidden (coordinated omission).
+ */
+static apr_time_t request_issue_time(struct io_workload *workload, struct io_request *request)
+{
+    if(request->scheduled > 0)
+        return workload->start_time + request->scheduled;
+    return request->pre_submission;
+}
+
 static apr_status_t read_complete(struct async_queue *queue, struct async_queue_entry *entry)
 {
 	apr_time_t elapsed;
 	struct io_request *request = &entry->request;
 	struct io_workload *workload = queue->workload;
-	uint64_t tmp;
-	uint64_t seed;
-	uint64_t *buf;
-	uint64_t i;
-	int64_t off;
-	uint64_t end;
+	uint64_t verify_size;
 
 	request->completed = apr_time_now();
-	elapsed = request->completed - request->pre_submission;
+	elapsed = request->completed - request_issue_time(workload, request);
+	workload->latency_histogram[latency_bucket(elapsed)] += 1;
 
     if(workload->read_requests == 0) {
         workload->read_min_latency = elapsed;
@@ -58,40 +63,18 @@ static apr_status_t read_complete(struct async_queue *queue, struct async_queue_
 	workload->read_bytes += request->size;
 	workload->read_elapsed += elapsed;
 
-	buf = (uint64_t*) request->buf;
-	i=0;
-	off = request->offset;
-    while(i < request->size && off < workload->worker->last_integrity_written_offset) {
-        tmp = *buf;
-        end = i + 512;
-        if(tmp != off) {
+    /* sectors starting below the highest written offset */
+    if(request->offset < workload->worker->last_integrity_written_offset) {
+        verify_size = workload->worker->last_integrity_written_offset - request->offset;
+        verify_size += (DATA_PATTERN_SECTOR - verify_size % DATA_PATTERN_SECTOR) % DATA_PATTERN_SECTOR;
+        if(verify_size > request->size)
+            verify_size = request->size;
+        if(workload->worker->options->verify_pool != NULL) {
+            /* verified by the pool before the entry is reused */
+            entry->verify_size = verify_size;
+        } else if(!data_pattern_verify(request->buf, verify_size, request->offset, workload->worker->options->write_random)) {
             integrity_error(request);
         }
-        ++buf;
-        i += sizeof(uint64_t);
-        if(workload->worker->options->write_random) {
-            seed = *buf;
-            i += sizeof(uint64_t);
-            ++buf;
-            while(i < end) {
-                tmp = random_uint64_t(&seed);
-                if(*buf != tmp) {
-                    printf("Random mismatch");
-                    integrity_error(request);
-                }
-                i += sizeof(uint64_t);
-                ++buf;
-            }
-        } else {
-            while(i < end) {
-                if(*buf != NONRANDOM_CONSTANT) {
-                   integrity_error(request);
-                }
-                i += sizeof(uint64_t);
-                ++buf;
-            }
-        }
-        off = request->offset + i;
     }
 
 #ifdef DEBUG
@@ -107,7 +90,8 @@ static apr_status_t write_complete(struct async_queue *queue, struct async_queue
 	struct io_workload *workload = queue->workload;
 
 	request->completed = apr_time_now();
-	elapsed = request->completed - request->pre_submission;
+	elapsed = request->completed - request_issue_time(workload, request);
+	workload->latency_histogram[latency_bucket(elapsed)] += 1;
 
     if(workload->write_requests == 0) {
         workload->write_min_latency = elapsed;
@@ -142,10 +126,16 @@ apr_status_t generic_queue_notify(
 {
 	apr_status_t rv;
 
+	ioop->verify_size = 0;
 	rv = ioop->callback(queue, ioop);
+	queue->active = queue->active - 1;
+	if(ioop->verify_size > 0) {
+		queue->verifying = queue->verifying + 1;
+		verify_pool_submit(queue->workload->worker->options->verify_pool, ioop);
+		return rv;
+	}
 	APR_RING_INSERT_TAIL(queue->ready, ioop, async_queue_entry, link);
 	queue->free = queue->free + 1;
-	queue->active = queue->active - 1;
 
 	return rv;
 }
@@ -158,16 +148,32 @@ apr_status_t generic_queue_wait(struct async_queue *queue, int *events)
 {
 	int oldActive;
 	int received=0;
+	int min_events;
 	apr_status_t rv;
 	while(queue->active > 0) {
+		/* verified entries may free a slot before the next completion */
+		if(queue->verifying > 0)
+			verify_pool_reap(queue, 0);
 		oldActive = queue->active;
-		rv = queue->workload->worker->options->platform_ops->queue_wait(queue, received<*events || queue->free == 0);
+		if(received < *events || queue->free == 0) {
+			/* reap in batches of at least reap_batch completions */
+			min_events = received < *events ? *events - received : 1;
+			if(min_events < queue->workload->worker->options->reap_batch)
+				min_events = queue->workload->worker->options->reap_batch;
+			if(min_events > queue->active)
+				min_events = queue->active;
+		} else {
+			min_events = 0;
+		}
+		rv = queue->workload->worker->options->platform_ops->queue_wait(queue, min_events);
 		assert(rv == APR_SUCCESS);
 		if(oldActive - queue->active <= 0)
 			break;
 
 		received += (oldActive - queue->active);
 	}
+	if(queue->verifying > 0)
+		verify_pool_reap(queue, queue->free == 0);
 
 	*events = received;
 	return APR_SUCCESS;
@@ -180,43 +186,34 @@ apr_status_t generic_queue_wait(struct async_queue *queue, int *events)
 apr_status_t generic_queue_barrier(struct async_queue *queue)
 {
 	int events = queue->active;
-	return generic_queue_wait(queue, &events);
+	apr_status_t rv;
+
+	rv = generic_queue_wait(queue, &events);
+	while(queue->verifying > 0)
+		verify_pool_reap(queue, 1);
+	return rv;
+}
+
+apr_status_t generic_queue_submit(struct async_queue *queue)
+{
+	struct platform_ops *ops = queue->workload->worker->options->platform_ops;
+
+	if(ops->queue_submit == NULL)
+		return APR_SUCCESS;
+
+	return ops->queue_submit(queue);
 }
 
 apr_status_t generic_queue_write(struct async_queue *queue, struct async_queue_entry *ioop)
 {
-	uint64_t *buf;
-	uint64_t i, end;
-	int64_t off;
 	struct io_worker *worker = queue->workload->worker;
     struct io_request *request = &ioop->request;
 
-	buf = (uint64_t*) request->buf;
-	i=0;
-	off = request->offset;
-    while(i < request->size) {
-        end = i + 512;
-		*buf = request->offset + i;
-		i += sizeof(uint64_t);
-        ++buf;
-
-        if(worker->options->write_random) {
-	        *buf = worker->random_seed;
-	        ++buf;
-            i += sizeof(uint64_t);
-            while(i < end) {
-                *buf = random_uint64_t(&worker->random_seed);
-                i += sizeof(uint64_t);
-                ++buf;
-            }
-        } else {
-            while(i < end) {
-                *buf = NONRANDOM_CONSTANT;
-                i += sizeof(uint64_t);
-                ++buf;
-            }
-        }
-        off = request->offset + i;
+    if(worker->pattern_pool != NULL && worker->options->write_random) {
+        data_pattern_fill_pool(request->buf, request->size, request->offset,
+                               worker->pattern_pool, worker->pattern_pool_sectors, &worker->random_seed);
+    } else {
+        data_pattern_fill(request->buf, request->size, request->offset, worker->options->write_random, &worker->random_seed);
     }
 
 #ifdef DEBUG
@@ -254,6 +251,7 @@ apr_status_t generic_queue_create(struct io_workload *workload,
 	(*queue)->total = workload->queue_depth;
 	(*queue)->free = workload->queue_depth;
 	(*queue)->active = 0;
+	(*queue)->verifying = 0;
 
 	(*queue)->ready = apr_pcalloc((*queue)->pool, sizeof(struct async_ioop_ring));
 	(*queue)->ioaqes = apr_pcalloc((*queue)->pool, sizeof(struct async_queue_entry)*workload->queue_depth);
@@ -268,7 +266,10 @@ apr_status_t generic_queue_create(struct io_workload *workload,
 		APR_RING_INSERT_TAIL((*queue)->ready, &((*queue)->ioaqes[i]), async_queue_entry, link);
         (*queue)->ioaqes[i].request.buf = worker->buf + i*bufsize;
         (*queue)->ioaqes[i].request.bufsize = bufsize;
+        (*queue)->ioaqes[i].owner = *queue;
 	}
+	if(worker->options->verify_pool != NULL)
+		(*queue)->verified = verify_ring_create((*queue)->pool, workload->queue_depth);
 
 	rv = worker->options->platform_ops->queue_create(*queue);
 	return rv;
@@ -24,6 +24,9 @@
     int write;
     uint64_t blocks;
     uint64_t req_size;
+    /* offset granularity, 0 to align to req_size */
+    uint64_t alignment;
+    uint64_t offset_unit;
 };
 
 static apr_status_t random_request_generator_fill_request(
@@ -37,7 +40,7 @@ static apr_status_t random_request_generator_fill_request(
 	uint64_t random_base = random_uint64_t(random_seed);
 
 	request->offset = random_base % data->blocks;
-	request->offset = request->offset  * data->req_size;
+	request->offset = request->offset  * data->offset_unit;
 
 
     request->size = data->req_size;
@@ -61,6 +64,9 @@ static uint64_t random_request_generator_weighted_iosize(struct io_workload_gene
 
 static apr_status_t random_request_generator_reset(struct io_workload_generator *template_generator, struct io_workload *workload, uint64_t reqsize)
 {
+    struct random_request_generator_data *data;
+    uint64_t span;
+
     if(workload->request_generator != NULL) {
         if(workload->request_generator->generator_data != NULL) {
             free(workload->request_generator->generator_data);
@@ -74,7 +80,20 @@ static apr_status_t random_request_generator_reset(struct io_workload_generator
     workload->request_generator->generator_data = malloc(sizeof(struct random_request_generator_data));
     memcpy(workload->request_generator->generator_data, template_generator->generator_data, sizeof(struct random_request_generator_data));
     workload->request_generator->workload = workload;
-    ((struct random_request_generator_data*) workload->request_generator->generator_data)->blocks = (workload->worker->filesize / reqsize);
+    data = (struct random_request_generator_data*) workload->request_generator->generator_data;
+    span = workload->worker->filesize;
+    if(workload->worker->options->working_set > 0 && workload->worker->options->working_set < span)
+        span = workload->worker->options->working_set;
+    if(data->alignment == 0 || data->alignment >= reqsize) {
+        data->offset_unit = data->alignment > reqsize ? data->alignment : reqsize;
+        data->blocks = (span / data->offset_unit);
+    } else {
+        /* every aligned position where the whole request fits */
+        data->offset_unit = data->alignment;
+        data->blocks = span >= reqsize ? (span - reqsize) / data->alignment + 1 : 0;
+    }
+    if(data->blocks == 0)
+        data->blocks = 1;
 
 
     return APR_SUCCESS;
@@ -84,10 +103,20 @@ apr_status_t random_request_generator_factory(
     struct io_workload_generator **request_generator,
     int write
 )
+{
+    return random_request_generator_aligned_factory(request_generator, write, 0);
+}
+
+apr_status_t random_request_generator_aligned_factory(
+    struct io_workload_generator **request_generator,
+    int write,
+    uint64_t alignment
+)
 {
     struct random_request_generator_data *data = calloc(1, sizeof(struct random_request_generator_data));
     *request_generator = malloc(sizeof(struct io_workload_generator));
     data->write = write;
+    data->alignment = alignment;
     (*request_generator)->generator_data = data;
     (*request_generator)->fill_request = &random_request_generator_fill_request;
     (*request_generator)->max_io_size = &random_request_generator_max_iosize;
@@ -0,0 +1,212 @@
+/*
+  * skewed_workload.c
+  *
+  * Part of diskBench - IO bandwidth measurement
+  *
+  * Copyright (C) 2010-2011  Amund Elstad <amund.elstad@gmail.com>
+  *
+  *  This program is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *   the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  This program is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *   GNU General Public License for more details.
+  *
+  *   You should have received a copy of the GNU General Public License
+  *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+#include "diskBench.h"
+
+/*
+ * Random requests with a skewed offset distribution.
+ *
+ * Zipfian ranks are drawn with the method of Gray et al, "Quickly generating
+ * billion-record synthetic databases", which is O(1) per request once zeta(n)
+ * is known. Ranks are hashed to blocks so the hot blocks are spread over the
+ * file instead of being packed at the start.
+ *
+ * Hotspot sends hot_io of the requests to the first hot_area of the file and
+ * the rest uniformly to the remainder.
+ */
+
+/* zeta(n) is summed exactly up to this many terms and integrated beyond */
+#define ZETA_EXACT_TERMS (1024*1024)
+
+ struct skewed_request_generator_data {
+    int write;
+    int distribution;
+    uint64_t blocks;
+    uint64_t req_size;
+
+    /* zipf */
+    double theta;
+    double alpha;
+    double zetan;
+    double eta;
+    double half_pow_theta;
+
+    /* hotspot, fractions of IOs and of the file */
+    double hot_io;
+    double hot_area;
+    uint64_t hot_blocks;
+};
+
+static double random_double(uint64_t *seed)
+{
+    /* 53 random bits in [0,1) */
+    return (random_uint64_t(seed) >> 11) * (1.0/9007199254740992.0);
+}
+
+static uint64_t hash_uint64_t(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= UINT64_C(0xbf58476d1ce4e5b9);
+    x ^= x >> 27;
+    x *= UINT64_C(0x94d049bb133111eb);
+    x ^= x >> 31;
+    return x;
+}
+
+static double zeta(uint64_t n, double theta)
+{
+    uint64_t exact = n < ZETA_EXACT_TERMS ? n : ZETA_EXACT_TERMS;
+    double sum = 0.0;
+    uint64_t i;
+
+    for(i=1; i <= exact; ++i) {
+        sum += 1.0 / pow((double) i, theta);
+    }
+    if(n > exact) {
+        /* midpoint integral of x^-theta over the remaining terms */
+        sum += (pow(n + 0.5, 1.0 - theta) - pow(exact + 0.5, 1.0 - theta)) / (1.0 - theta);
+    }
+    return sum;
+}
+
+static apr_status_t skewed_request_generator_fill_request(
+    struct io_workload_generator *workload_generator,
+    struct io_request *request
+)
+{
+    struct skewed_request_generator_data *data = (struct skewed_request_generator_data*) workload_generator->generator_data;
+    uint64_t *random_seed = &workload_generator->workload->worker->random_seed;
+    uint64_t block;
+    double u, uz;
+
+    if(data->distribution == SKEW_ZIPF) {
+        u = random_double(random_seed);
+        uz = u * data->zetan;
+        if(uz < 1.0) {
+            block = 0;
+        } else if(uz < 1.0 + data->half_pow_theta) {
+            block = 1;
+        } else {
+            block = (uint64_t) (data->blocks * pow(data->eta*u - data->eta + 1.0, data->alpha));
+        }
+        block = hash_uint64_t(block) % data->blocks;
+    } else {
+        if(random_double(random_seed) < data->hot_io || data->hot_blocks == data->blocks) {
+            block = random_uint64_t(random_seed) % data->hot_blocks;
+        } else {
+            block = data->hot_blocks + random_uint64_t(random_seed) % (data->blocks - data->hot_blocks);
+        }
+    }
+
+    request->offset = block * data->req_size;
+    request->size = data->req_size;
+    request->write = data->write;
+
+    return APR_SUCCESS;
+}
+
+static uint64_t skewed_request_generator_max_iosize(struct io_workload_generator *workload_generator)
+{
+    struct skewed_request_generator_data *data = (struct skewed_request_generator_data*) workload_generator->generator_data;
+
+    return data->req_size;
+}
+
+static uint64_t skewed_request_generator_weighted_iosize(struct io_workload_generator *workload_generator)
+{
+    return UINT64_C(4*1024);
+}
+
+
+static apr_status_t skewed_request_generator_reset(struct io_workload_generator *template_generator, struct io_workload *workload, uint64_t reqsize)
+{
+    struct skewed_request_generator_data *template_data = (struct skewed_request_generator_data*) template_generator->generator_data;
+    struct skewed_request_generator_data *data;
+    uint64_t blocks;
+
+    if(workload->request_generator != NULL) {
+        if(workload->request_generator->generator_data != NULL) {
+            free(workload->request_generator->generator_data);
+        }
+        free(workload->request_generator);
+        workload->request_generator = NULL;
+    }
+    template_data->req_size = reqsize;
+    blocks = workload->worker->filesize / reqsize;
+    if(blocks == 0)
+        blocks = 1;
+
+    /* zeta is costly for large files, reuse it while the block count is unchanged */
+    if(template_data->distribution == SKEW_ZIPF && template_data->blocks != blocks) {
+        template_data->blocks = blocks;
+        template_data->zetan = zeta(blocks, template_data->theta);
+        template_data->alpha = 1.0 / (1.0 - template_data->theta);
+        template_data->half_pow_theta = pow(0.5, template_data->theta);
+        template_data->eta = (1.0 - pow(2.0 / blocks, 1.0 - template_data->theta))
+            / (1.0 - zeta(2, template_data->theta) / template_data->zetan);
+    }
+    template_data->blocks = blocks;
+    template_data->hot_blocks = (uint64_t) (blocks * template_data->hot_area);
+    if(template_data->hot_blocks == 0)
+        template_data->hot_blocks = 1;
+
+    workload->request_generator = malloc(sizeof(struct io_workload_generator));
+    memcpy(workload->request_generator, template_generator, sizeof(struct io_workload_generator));
+    data = malloc(sizeof(struct skewed_request_generator_data));
+    memcpy(data, template_data, sizeof(struct skewed_request_generator_data));
+    workload->request_generator->generator_data = data;
+    workload->request_generator->workload = workload;
+
+    return APR_SUCCESS;
+}
+
+apr_status_t skewed_request_generator_factory(
+    struct io_workload_generator **request_generator,
+    int write,
+    int distribution,
+    double param1,
+    double param2
+)
+{
+    struct skewed_request_generator_data *data = calloc(1, sizeof(struct skewed_request_generator_data));
+
+    if(distribution == SKEW_ZIPF && (param1 <= 0.0 || param1 >= 1.0)) {
+        free(data);
+        return APR_EINVAL;
+    }
+    if(distribution == SKEW_HOTSPOT && (param1 < 0.0 || param1 > 1.0 || param2 <= 0.0 || param2 > 1.0)) {
+        free(data);
+        return APR_EINVAL;
+    }
+
+    *request_generator = malloc(sizeof(struct io_workload_generator));
+    data->write = write;
+    data->distribution = distribution;
+    data->theta = param1;
+    data->hot_io = param1;
+    data->hot_area = param2;
+    (*request_generator)->generator_data = data;
+    (*request_generator)->fill_request = &skewed_request_generator_fill_request;
+    (*request_generator)->max_io_size = &skewed_request_generator_max_iosize;
+    (*request_generator)->weighted_io_size = &skewed_request_generator_weighted_iosize;
+    (*request_generator)->reset = &skewed_request_generator_reset;
+
+    return APR_SUCCESS;
+}
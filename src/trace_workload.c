@@ -0,0 +1,285 @@
+/*
+  * trace_workload.c
+  *
+  * Part of diskBench - IO bandwidth measurement
+  *
+  * Copyright (C) 2010-2011  Amund Elstad <amund.elstad@gmail.com>
+  *
+  *  This program is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *   the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  This program is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *   GNU General Public License for more details.
+  *
+  *   You should have received a copy of the GNU General Public License
+  *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+#include "diskBench.h"
+#include "apr_file_io.h"
+#include "apr_mmap.h"
+
+/*
+ * Replay of recorded IO traces. Two text formats are understood, line by line:
+ *
+ *   blkparse:  8,0  3  1  0.000000000  697  Q  W  223490 + 8 [kjournald]
+ *              Only queue (Q) events are replayed. Offsets/sizes are sectors.
+ *   CSV:       <timestamp in seconds>,<R|W|read|write>,<offset>,<size>
+ *              Offsets/sizes are bytes. Other lines (headers) are skipped.
+ *
+ * The trace is memory mapped and parsed while replaying, so traces larger
+ * than memory work. It is replayed in a loop until the test ends. Offsets and
+ * sizes are aligned to the configured sector size and offsets are scaled onto
+ * the file when the trace spans more than the file. Requests larger than the
+ * buffer slice are truncated.
+ */
+
+/* blkparse reports offsets and sizes in 512 byte units */
+#define BLKPARSE_SECTOR 512
+#define TRACE_MAX_LINE 512
+
+struct trace_record {
+    double timestamp;
+    int write;
+    uint64_t offset;
+    uint64_t size;
+};
+
+ struct trace_request_generator_data {
+    /* mapped trace, shared by all instances */
+    const char *map;
+    apr_size_t length;
+
+    int timed;
+
+    /* from the scan of the whole trace */
+    double first_timestamp;
+    double duration;
+    uint64_t span;
+    uint64_t max_size;
+
+    uint64_t req_size;
+    uint64_t filesize;
+    uint64_t sector_size;
+
+    /* replay position */
+    apr_size_t pos;
+    uint64_t loops;
+};
+
+static int trace_parse_line(const char *line, struct trace_record *record)
+{
+    int major, minor, cpu, pid;
+    unsigned int seq, sectors;
+    unsigned long long value1, value2;
+    char action[8];
+    char rwbs[8];
+    char op[16];
+
+    if(sscanf(line, "%d,%d %d %u %lf %d %7s %7s %llu + %u",
+              &major, &minor, &cpu, &seq, &(record->timestamp), &pid, action, rwbs, &value1, &sectors) == 10) {
+        if(strcmp(action, "Q") != 0)
+            return 0;
+        if(strchr(rwbs, 'W') != NULL) {
+            record->write = 1;
+        } else if(strchr(rwbs, 'R') != NULL) {
+            record->write = 0;
+        } else {
+            return 0;
+        }
+        record->offset = value1 * BLKPARSE_SECTOR;
+        record->size = (uint64_t) sectors * BLKPARSE_SECTOR;
+        return record->size > 0;
+    }
+
+    if(sscanf(line, "%lf , %15[A-Za-z] , %llu , %llu", &(record->timestamp), op, &value1, &value2) == 4) {
+        if(op[0] == 'W' || op[0] == 'w') {
+            record->write = 1;
+        } else if(op[0] == 'R' || op[0] == 'r') {
+            record->write = 0;
+        } else {
+            return 0;
+        }
+        record->offset = value1;
+        record->size = value2;
+        return record->size > 0;
+    }
+    return 0;
+}
+
+/* Parse next replayable record at or after *pos. Returns 0 at end of trace */
+static int trace_next_record(const char *map, apr_size_t length, apr_size_t *pos, struct trace_record *record)
+{
+    char line[TRACE_MAX_LINE];
+    apr_size_t start, len;
+
+    while(*pos < length) {
+        start = *pos;
+        while(*pos < length && map[*pos] != '\n')
+            ++(*pos);
+        len = *pos - start;
+        if(*pos < length)
+            ++(*pos);
+
+        if(len >= TRACE_MAX_LINE)
+            continue;
+        memcpy(line, map + start, len);
+        line[len] = '\0';
+        if(trace_parse_line(line, record))
+            return 1;
+    }
+    return 0;
+}
+
+static apr_status_t trace_request_generator_fill_request(
+    struct io_workload_generator *workload_generator,
+    struct io_request *request
+)
+{
+    struct trace_request_generator_data *data = (struct trace_request_generator_data*) workload_generator->generator_data;
+    struct trace_record record;
+    uint64_t offset;
+
+    if(!trace_next_record(data->map, data->length, &(data->pos), &record)) {
+        /* start over */
+        data->pos = 0;
+        data->loops = data->loops + 1;
+        if(!trace_next_record(data->map, data->length, &(data->pos), &record))
+            return APR_EGENERAL;
+    }
+
+    request->size = record.size + (data->sector_size - record.size % data->sector_size) % data->sector_size;
+    if(request->size > data->req_size)
+        request->size = data->req_size;
+    if(request->size > data->filesize)
+        request->size = data->filesize - data->filesize % data->sector_size;
+
+    offset = record.offset;
+    if(data->span > data->filesize) {
+        /* scale trace onto the file */
+        offset = (uint64_t) ((double) offset / data->span * data->filesize);
+    }
+    offset = offset - offset % data->sector_size;
+    if(offset + request->size > data->filesize)
+        offset = data->filesize - request->size - (data->filesize - request->size) % data->sector_size;
+
+    request->offset = offset;
+    request->write = record.write;
+    if(data->timed) {
+        request->scheduled = (apr_time_t)
+            ((record.timestamp - data->first_timestamp + data->loops * data->duration) * APR_USEC_PER_SEC);
+        if(request->scheduled <= 0)
+            request->scheduled = 1;
+    }
+
+    return APR_SUCCESS;
+}
+
+static uint64_t trace_request_generator_max_iosize(struct io_workload_generator *workload_generator)
+{
+    struct trace_request_generator_data *data = (struct trace_request_generator_data*) workload_generator->generator_data;
+
+    return data->req_size;
+}
+
+static uint64_t trace_request_generator_weighted_iosize(struct io_workload_generator *workload_generator)
+{
+    struct trace_request_generator_data *data = (struct trace_request_generator_data*) workload_generator->generator_data;
+
+    return data->max_size;
+}
+
+
+static apr_status_t trace_request_generator_reset(struct io_workload_generator *template_generator, struct io_workload *workload, uint64_t reqsize)
+{
+    struct trace_request_generator_data *data;
+
+    if(workload->request_generator != NULL) {
+        if(workload->request_generator->generator_data != NULL) {
+            free(workload->request_generator->generator_data);
+        }
+        free(workload->request_generator);
+        workload->request_generator = NULL;
+    }
+    ((struct trace_request_generator_data*) template_generator->generator_data)->req_size = reqsize;
+
+    workload->request_generator = malloc(sizeof(struct io_workload_generator));
+    memcpy(workload->request_generator, template_generator, sizeof(struct io_workload_generator));
+    data = malloc(sizeof(struct trace_request_generator_data));
+    memcpy(data, template_generator->generator_data, sizeof(struct trace_request_generator_data));
+    data->filesize = workload->worker->filesize;
+    data->sector_size = workload->worker->options->sector_size;
+    /* round up, a slice of the IO buffer is page aligned already */
+    data->req_size = data->req_size + (data->sector_size - data->req_size % data->sector_size) % data->sector_size;
+    data->pos = 0;
+    data->loops = 0;
+    workload->request_generator->generator_data = data;
+    workload->request_generator->workload = workload;
+
+    return APR_SUCCESS;
+}
+
+apr_status_t trace_request_generator_factory(
+    struct io_workload_generator **request_generator,
+    const char *filename,
+    int timed,
+    apr_pool_t *pool
+)
+{
+    struct trace_request_generator_data *data;
+    struct trace_record record;
+    apr_file_t *file;
+    apr_finfo_t finfo;
+    apr_mmap_t *mm;
+    apr_size_t pos = 0;
+    uint64_t records = 0;
+    double last_timestamp = 0.0;
+    apr_status_t rv;
+
+    rv = apr_file_open(&file, filename, APR_READ, 0, pool);
+    if(rv != APR_SUCCESS)
+        return rv;
+    rv = apr_file_info_get(&finfo, APR_FINFO_SIZE, file);
+    if(rv != APR_SUCCESS)
+        return rv;
+    if(finfo.size == 0)
+        return APR_EINVAL;
+    rv = apr_mmap_create(&mm, file, 0, (apr_size_t) finfo.size, APR_MMAP_READ, pool);
+    if(rv != APR_SUCCESS)
+        return rv;
+
+    data = calloc(1, sizeof(struct trace_request_generator_data));
+    data->map = mm->mm;
+    data->length = mm->size;
+    data->timed = timed;
+
+    /* one pass to find span, duration and largest request */
+    while(trace_next_record(data->map, data->length, &pos, &record)) {
+        if(records == 0)
+            data->first_timestamp = record.timestamp;
+        last_timestamp = record.timestamp;
+        if(record.offset + record.size > data->span)
+            data->span = record.offset + record.size;
+        if(record.size > data->max_size)
+            data->max_size = record.size;
+        ++records;
+    }
+    if(records == 0) {
+        free(data);
+        return APR_EINVAL;
+    }
+    data->duration = last_timestamp - data->first_timestamp;
+    data->req_size = data->max_size;
+
+    *request_generator = malloc(sizeof(struct io_workload_generator));
+    (*request_generator)->generator_data = data;
+    (*request_generator)->fill_request = &trace_request_generator_fill_request;
+    (*request_generator)->max_io_size = &trace_request_generator_max_iosize;
+    (*request_generator)->weighted_io_size = &trace_request_generator_weighted_iosize;
+    (*request_generator)->reset = &trace_request_generator_reset;
+
+    return APR_SUCCESS;
+}
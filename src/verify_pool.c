@@ -0,0 +1,231 @@
+/*
+  * verify_pool.c
+  *
+  * Part of diskBench - IO bandwidth measurement
+  *
+  * Copyright (C) 2010-2011  Amund Elstad <amund.elstad@gmail.com>
+  *
+  *  This program is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *   the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  This program is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *   GNU General Public License for more details.
+  *
+  *   You should have received a copy of the GNU General Public License
+  *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+#include "diskBench.h"
+
+/*
+ * Pipelined read verification. Completed reads are pushed to a ring shared
+ * by all workers and verified by a pool of threads, which push the entries
+ * back to the verified ring of their queue. The ioworker reaps that ring and
+ * only then returns the entries to its ready ring, so a buffer is never
+ * reused before it has been checked.
+ *
+ * Both rings are bounded lock-free queues (one sequence number per cell,
+ * positions claimed with compare-and-swap), so neither the ioworkers nor the
+ * verifiers take a lock per request.
+ */
+
+/* Entries in the shared ring, producers yield while it is full */
+#define VERIFY_POOL_CAPACITY 16384
+/* Idle verifiers spin this many times before sleeping */
+#define VERIFY_SPIN 64
+#define VERIFY_POLL_INTERVAL 50
+
+struct verify_cell {
+    volatile apr_uint32_t sequence;
+    struct async_queue_entry *entry;
+};
+
+struct verify_ring {
+    apr_uint32_t mask;
+    struct verify_cell *cells;
+    volatile apr_uint32_t enqueue_pos;
+    volatile apr_uint32_t dequeue_pos;
+};
+
+struct verify_pool {
+    struct verify_ring *ring;
+    apr_thread_t **threads;
+    int thread_count;
+    volatile apr_uint32_t shutdown;
+};
+
+struct verify_ring *verify_ring_create(apr_pool_t *pool, uint32_t capacity)
+{
+    struct verify_ring *ring = apr_pcalloc(pool, sizeof(struct verify_ring));
+    uint32_t size = 2;
+    uint32_t i;
+
+    while(size < capacity)
+        size = size * 2;
+    ring->mask = size - 1;
+    ring->cells = apr_pcalloc(pool, sizeof(struct verify_cell)*size);
+    for(i=0; i < size; ++i) {
+        apr_atomic_set32(&ring->cells[i].sequence, i);
+    }
+    apr_atomic_set32(&ring->enqueue_pos, 0);
+    apr_atomic_set32(&ring->dequeue_pos, 0);
+    return ring;
+}
+
+/* Returns 0 if the ring is full */
+static int verify_ring_push(struct verify_ring *ring, struct async_queue_entry *entry)
+{
+    struct verify_cell *cell;
+    apr_uint32_t pos = apr_atomic_read32(&ring->enqueue_pos);
+    int32_t diff;
+
+    for(;;) {
+        cell = &ring->cells[pos & ring->mask];
+        diff = (int32_t) (apr_atomic_read32(&cell->sequence) - pos);
+        if(diff == 0) {
+            if(apr_atomic_cas32(&ring->enqueue_pos, pos + 1, pos) == pos)
+                break;
+            pos = apr_atomic_read32(&ring->enqueue_pos);
+        } else if(diff < 0) {
+            return 0;
+        } else {
+            pos = apr_atomic_read32(&ring->enqueue_pos);
+        }
+    }
+    cell->entry = entry;
+    apr_atomic_set32(&cell->sequence, pos + 1);
+    return 1;
+}
+
+/* Returns NULL if the ring is empty */
+static struct async_queue_entry *verify_ring_pop(struct verify_ring *ring)
+{
+    struct verify_cell *cell;
+    struct async_queue_entry *entry;
+    apr_uint32_t pos = apr_atomic_read32(&ring->dequeue_pos);
+    int32_t diff;
+
+    for(;;) {
+        cell = &ring->cells[pos & ring->mask];
+        diff = (int32_t) (apr_atomic_read32(&cell->sequence) - (pos + 1));
+        if(diff == 0) {
+            if(apr_atomic_cas32(&ring->dequeue_pos, pos + 1, pos) == pos)
+                break;
+            pos = apr_atomic_read32(&ring->dequeue_pos);
+        } else if(diff < 0) {
+            return NULL;
+        } else {
+            pos = apr_atomic_read32(&ring->dequeue_pos);
+        }
+    }
+    entry = cell->entry;
+    apr_atomic_set32(&cell->sequence, pos + ring->mask + 1);
+    return entry;
+}
+
+static void *APR_THREAD_FUNC verify_thread(apr_thread_t *thd, void *data)
+{
+    struct verify_pool *pool = (struct verify_pool *) data;
+    struct async_queue_entry *entry;
+    struct io_request *request;
+    int idle = 0;
+
+    while(!apr_atomic_read32(&pool->shutdown)) {
+        entry = verify_ring_pop(pool->ring);
+        if(entry == NULL) {
+            if(++idle < VERIFY_SPIN) {
+                apr_thread_yield();
+            } else {
+                apr_sleep(VERIFY_POLL_INTERVAL);
+            }
+            continue;
+        }
+        idle = 0;
+
+        request = &entry->request;
+        entry->verify_start = apr_time_now();
+        if(!data_pattern_verify(request->buf, entry->verify_size, request->offset,
+                                entry->owner->workload->worker->options->write_random))
+            integrity_error(request);
+        entry->verify_end = apr_time_now();
+
+        /* sized for the whole queue, never full */
+        verify_ring_push(entry->owner->verified, entry);
+    }
+
+    apr_thread_exit(thd, APR_SUCCESS);
+    return NULL;
+}
+
+apr_status_t verify_pool_create(struct verify_pool **verify_pool, int threads, apr_pool_t *pool)
+{
+    struct verify_pool *p;
+    apr_status_t rv;
+    int i;
+
+    p = apr_pcalloc(pool, sizeof(struct verify_pool));
+    p->ring = verify_ring_create(pool, VERIFY_POOL_CAPACITY);
+    p->thread_count = threads;
+    apr_atomic_set32(&p->shutdown, 0);
+    p->threads = apr_pcalloc(pool, sizeof(apr_thread_t*)*threads);
+    for(i=0; i < threads; ++i) {
+        rv = apr_thread_create(&(p->threads[i]), NULL, verify_thread, p, pool);
+        if(rv != APR_SUCCESS)
+            return rv;
+    }
+    *verify_pool = p;
+    return APR_SUCCESS;
+}
+
+apr_status_t verify_pool_destroy(struct verify_pool *verify_pool)
+{
+    apr_status_t rv;
+    int i;
+
+    apr_atomic_set32(&verify_pool->shutdown, 1);
+    for(i=0; i < verify_pool->thread_count; ++i) {
+        apr_thread_join(&rv, verify_pool->threads[i]);
+    }
+    return APR_SUCCESS;
+}
+
+void verify_pool_submit(struct verify_pool *verify_pool, struct async_queue_entry *entry)
+{
+    while(!verify_ring_push(verify_pool->ring, entry)) {
+        apr_thread_yield();
+    }
+}
+
+/*
+ * Return verified entries of queue to its ready ring. With block set, wait
+ * until at least one entry came back (if any are out for verification)
+ */
+int verify_pool_reap(struct async_queue *queue, int block)
+{
+    struct io_workload *workload = queue->workload;
+    struct async_queue_entry *entry;
+    int reaped = 0;
+
+    while(queue->verifying > 0) {
+        entry = verify_ring_pop(queue->verified);
+        if(entry == NULL) {
+            if(!block || reaped > 0)
+                break;
+            apr_thread_yield();
+            continue;
+        }
+        workload->verify_requests += 1;
+        workload->verify_bytes += entry->verify_size;
+        workload->verify_elapsed += entry->verify_end - entry->verify_start;
+        workload->verify_delay += entry->verify_end - entry->request.completed;
+
+        APR_RING_INSERT_TAIL(queue->ready, entry, async_queue_entry, link);
+        queue->free = queue->free + 1;
+        queue->verifying = queue->verifying - 1;
+        reaped++;
+    }
+    return reaped;
+}
@@ -0,0 +1,121 @@
+/*
+  * wal_workload.c
+  *
+  * Part of diskBench - IO bandwidth measurement
+  *
+  * Copyright (C) 2010-2011  Amund Elstad <amund.elstad@gmail.com>
+  *
+  *  This program is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *   the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  This program is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *   GNU General Public License for more details.
+  *
+  *   You should have received a copy of the GNU General Public License
+  *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+#include "diskBench.h"
+
+/*
+ * Write-ahead log writes. The commits themselves (fdatasync after every
+ * commit_writes writes or commit_interval) are issued by ioworker.
+ *
+ *   WAL_APPEND     log records follow each other through the whole file.
+ *   WAL_OVERWRITE  every commit group rewrites the same blocks at the start
+ *                  of the file, like a log tail that is rewritten until full.
+ */
+
+ struct wal_request_generator_data {
+    int mode;
+    uint64_t group_blocks;
+    uint64_t req_size;
+    uint64_t off;
+    uint64_t span;
+};
+
+static apr_status_t wal_request_generator_fill_request(
+    struct io_workload_generator *workload_generator,
+    struct io_request *request
+)
+{
+    struct wal_request_generator_data *data = (struct wal_request_generator_data*) workload_generator->generator_data;
+
+    if(data->off + data->req_size > data->span)
+        data->off = 0;
+
+    request->offset = data->off;
+    request->size = data->req_size;
+    request->write = 1;
+    data->off += data->req_size;
+
+    return APR_SUCCESS;
+}
+
+static uint64_t wal_request_generator_max_iosize(struct io_workload_generator *workload_generator)
+{
+    struct wal_request_generator_data *data = (struct wal_request_generator_data*) workload_generator->generator_data;
+
+    return data->req_size;
+}
+
+static uint64_t wal_request_generator_weighted_iosize(struct io_workload_generator *workload_generator)
+{
+    return UINT64_C(4*1024);
+}
+
+
+static apr_status_t wal_request_generator_reset(struct io_workload_generator *template_generator, struct io_workload *workload, uint64_t reqsize)
+{
+    struct wal_request_generator_data *data;
+
+    if(workload->request_generator != NULL) {
+        if(workload->request_generator->generator_data != NULL) {
+            free(workload->request_generator->generator_data);
+        }
+        free(workload->request_generator);
+        workload->request_generator = NULL;
+    }
+    ((struct wal_request_generator_data*) template_generator->generator_data)->req_size = reqsize;
+
+    workload->request_generator = malloc(sizeof(struct io_workload_generator));
+    memcpy(workload->request_generator, template_generator, sizeof(struct io_workload_generator));
+    data = malloc(sizeof(struct wal_request_generator_data));
+    memcpy(data, template_generator->generator_data, sizeof(struct wal_request_generator_data));
+
+    data->off = 0;
+    data->span = workload->worker->filesize;
+    if(data->mode == WAL_OVERWRITE && data->group_blocks * reqsize < data->span)
+        data->span = data->group_blocks * reqsize;
+    workload->request_generator->generator_data = data;
+    workload->request_generator->workload = workload;
+
+    return APR_SUCCESS;
+}
+
+apr_status_t wal_request_generator_factory(
+    struct io_workload_generator **request_generator,
+    int mode,
+    int group_writes
+)
+{
+    struct wal_request_generator_data *data;
+
+    if(mode != WAL_APPEND && mode != WAL_OVERWRITE)
+        return APR_EINVAL;
+
+    data = calloc(1, sizeof(struct wal_request_generator_data));
+    *request_generator = malloc(sizeof(struct io_workload_generator));
+    data->mode = mode;
+    data->group_blocks = group_writes > 0 ? group_writes : 1;
+    (*request_generator)->generator_data = data;
+    (*request_generator)->fill_request = &wal_request_generator_fill_request;
+    (*request_generator)->max_io_size = &wal_request_generator_max_iosize;
+    (*request_generator)->weighted_io_size = &wal_request_generator_weighted_iosize;
+    (*request_generator)->reset = &wal_request_generator_reset;
+
+    return APR_SUCCESS;
+}
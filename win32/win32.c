@@ -47,15 +47,48 @@ static apr_size_t win32_get_min_iosize()
 	return 512;
 }
 
-static apr_status_t win32_create_io_buffer(void **buf, uint64_t size)
+static apr_status_t win32_get_cpu_time(apr_time_t *cpu_time)
 {
+    FILETIME creation, exit, kernel, user;
+    ULARGE_INTEGER k, u;
+
+    if(GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user) == 0)
+        return APR_EGENERAL;
+
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+
+    /* 100ns units */
+    *cpu_time = (k.QuadPart + u.QuadPart) / 10;
+    return APR_SUCCESS;
+}
+
+static apr_status_t win32_create_io_buffer(void **buf, uint64_t size, int flags, int *used_flags)
+{
+    uint64_t i;
+
+    *used_flags = 0;
     if(size % win32_get_page_size() != 0)
         // round up to nearest page-size
         size = (size/win32_get_page_size() + 1)*win32_get_page_size();
 
+    // large pages need SeLockMemoryPrivilege, not supported
     *buf = VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if(*buf == NULL)
+        return APR_ENOMEM;
 
-    return (*buf != NULL) ? APR_SUCCESS : APR_ENOMEM;
+    if(flags & IO_BUFFER_POPULATE) {
+        for(i=0; i < size; i += win32_get_page_size())
+            ((volatile char *) *buf)[i] = 0;
+        *used_flags |= IO_BUFFER_POPULATE;
+    }
+    if((flags & IO_BUFFER_LOCK) && VirtualLock(*buf, size)) {
+        *used_flags |= IO_BUFFER_LOCK;
+    }
+
+    return APR_SUCCESS;
 }
 
 static apr_status_t win32_file_truncate(struct platform_file *the_file, uint64_t *length)
@@ -79,7 +112,7 @@ static apr_status_t win32_file_truncate(struct platform_file *the_file, uint64_t
 
 
 
-static apr_status_t win32_file_open(char *filename, uint64_t *length, double freespace_percentage,
+static apr_status_t win32_file_open(char *filename, int buffered, uint64_t *length, double freespace_percentage,
                                     int *file_truncated, struct platform_file **rv)
 {
 	struct win32_platform_file *file;
@@ -101,7 +134,7 @@ static apr_status_t win32_file_open(char *filename, uint64_t *length, double fre
                    FILE_SHARE_READ|FILE_SHARE_WRITE, 		 // share read/write
                    NULL,                  // default security
                    OPEN_EXISTING,
-                   FILE_FLAG_NO_BUFFERING|FILE_FLAG_OVERLAPPED, // normal file
+                   (buffered ? 0 : FILE_FLAG_NO_BUFFERING)|FILE_FLAG_OVERLAPPED, // normal file
                    NULL);                 // no attr. template
 
 	if(hFile == INVALID_HANDLE_VALUE) {
@@ -110,7 +143,7 @@ static apr_status_t win32_file_open(char *filename, uint64_t *length, double fre
                    FILE_SHARE_READ|FILE_SHARE_WRITE, 		   // share read/write
                    NULL,                  // default security
                    CREATE_ALWAYS,
-                   FILE_FLAG_NO_BUFFERING|FILE_FLAG_OVERLAPPED, // normal file
+                   (buffered ? 0 : FILE_FLAG_NO_BUFFERING)|FILE_FLAG_OVERLAPPED, // normal file
                    NULL);                 // no attr. template
 	}
 	if(hFile == INVALID_HANDLE_VALUE)
@@ -293,7 +326,7 @@ static apr_status_t win32_queue_write(struct async_queue *queue, struct async_qu
 	return WriteFile(file->hFile, ioop->request.buf, ioop->request.size, NULL, overlapped)!=0 || GetLastError()==ERROR_IO_PENDING ? APR_SUCCESS : APR_EGENERAL;
 }
 
-static apr_status_t win32_queue_wait(struct async_queue *queue, int block)
+static apr_status_t win32_queue_wait(struct async_queue *queue, int min_events)
 {
     DWORD bytesTransfered;
     OVERLAPPED* pov = NULL;
@@ -303,8 +336,8 @@ static apr_status_t win32_queue_wait(struct async_queue *queue, int block)
 	struct win32_async_queue *q = (struct win32_async_queue*) queue->platform_queue;
     struct win32_platform_file *file = (struct win32_platform_file*) queue->workload->worker->file;
 
-	rv = GetQueuedCompletionStatus(file->completionPort, &bytesTransfered, &key, &pov, block ? INFINITE : 0);
-    if(!rv && !block && pov == NULL) {
+	rv = GetQueuedCompletionStatus(file->completionPort, &bytesTransfered, &key, &pov, min_events > 0 ? INFINITE : 0);
+    if(!rv && min_events == 0 && pov == NULL) {
         return APR_SUCCESS;
     }
 
@@ -323,17 +356,35 @@ struct platform_ops win32_platform_ops = {
     &win32_create_io_buffer,
     &win32_get_page_size,
 	&win32_get_min_iosize,
+	NULL,
+	&win32_get_cpu_time,
+	NULL,
+	NULL,
+	NULL,
 	&win32_file_open,
 	&win32_file_truncate,
 	&win32_file_close,
 	&win32_file_flush,
+	&win32_file_flush,
+	NULL,
+	NULL,
+	NULL,
 	&win32_queue_create,
 	&win32_queue_destroy,
 	&win32_queue_read,
 	&win32_queue_write,
-	&win32_queue_wait
+	&win32_queue_wait,
+	NULL,
+	"iocp"
 };
 
 
 struct platform_ops *platform_ops = &win32_platform_ops;
 
+struct platform_ops *platform_ops_lookup(const char *name)
+{
+	if(strcmp(win32_platform_ops.name, name) == 0)
+		return &win32_platform_ops;
+	return NULL;
+}
+